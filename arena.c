@@ -0,0 +1,107 @@
+/*
+** Chunked arena allocator: see arena.h
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include "arena.h"
+
+/*
+** Create an empty arena of elements of elemSize bytes.
+*/
+Arena *
+arena_new(size_t elemSize) {
+   Arena *a = (Arena *)malloc(sizeof(Arena));
+   assert(a != NULL);
+   a->elemSize  = elemSize;
+   a->nChunks   = 0;
+   a->chunksCap = 0;
+   a->chunks    = NULL;
+   a->next      = 1;      // 0 is reserved for NULL
+   return a;
+}//arena_new()
+
+/*
+** Return the handle of a new (uninitialised) element.
+*/
+uint32_t
+arena_alloc(Arena *a) {
+   int chunk = a->next >> ARENA_CHUNK_BITS;
+   if (chunk == a->nChunks) {
+      if (a->nChunks == a->chunksCap) {
+         a->chunksCap = a->chunksCap == 0 ? 64 : 2 * a->chunksCap;
+         a->chunks = (char **)realloc(a->chunks, sizeof(char *) * a->chunksCap);
+         assert(a->chunks != NULL);
+      }
+      a->chunks[a->nChunks] = (char *)malloc(a->elemSize * ARENA_CHUNK);
+      assert(a->chunks[a->nChunks] != NULL);
+      a->nChunks++;
+   }
+   assert(a->next != UINT32_MAX);
+   return a->next++;
+}//arena_alloc()
+
+/*
+** Forget every element but keep the chunks for reuse.
+*/
+void
+arena_reset(Arena *a) {
+   a->next = 1;
+}//arena_reset()
+
+/*
+** Release all memory held by a.
+*/
+void
+arena_free(Arena *a) {
+   for(int i = 0 ; i < a->nChunks ; i++)
+      free(a->chunks[i]);
+   free(a->chunks);
+   free(a);
+}//arena_free()
+
+/*
+** Write the elements of a to f, so arena_read() gives back the same handles.
+** Returns 0, or -1 on a write error.
+*/
+int
+arena_write(const Arena *a, FILE *f) {
+   if (fwrite(&a->next, sizeof(a->next), 1, f) != 1)
+      return -1;
+   for(int c = 0 ; c < a->nChunks ; c++) {
+      uint32_t first = c == 0 ? 1 : (uint32_t)c << ARENA_CHUNK_BITS;
+      uint64_t last  = ((uint64_t)c + 1) << ARENA_CHUNK_BITS;   // one past
+      if (last > a->next)
+         last = a->next;
+      if (first >= last)
+         break;
+      size_t n = last - first;
+      if (fwrite(arena_at(a, first), a->elemSize, n, f) != n)
+         return -1;
+   }
+   return 0;
+}//arena_write()
+
+/*
+** Fill the empty arena a from f (as written by arena_write()).
+** Returns 0, or -1 if f is short.
+*/
+int
+arena_read(Arena *a, FILE *f) {
+   assert(a->next == 1);
+   uint32_t next;
+   if (fread(&next, sizeof(next), 1, f) != 1 || next == 0)
+      return -1;
+   while (a->next < next) {
+      uint32_t first = a->next;
+      uint64_t last  = ((uint64_t)(first >> ARENA_CHUNK_BITS) + 1) << ARENA_CHUNK_BITS;
+      if (last > next)
+         last = next;
+      arena_alloc(a);         // makes the chunk
+      a->next = (uint32_t)last;
+      size_t n = last - first;
+      if (fread(arena_at(a, first), a->elemSize, n, f) != n)
+         return -1;
+   }
+   return 0;
+}//arena_read()
@@ -0,0 +1,44 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+** Chunked arena of fixed size elements addressed by 32-bit handles.
+**
+** Elements are carved out of ARENA_CHUNK elements at a time and never move,
+** so a pointer from arena_at() stays valid until the arena is reset or freed.
+** There is no per-element free: the whole arena goes at once.
+** Handle 0 is never returned, so callers can use it as NULL.
+*/
+
+#define ARENA_CHUNK_BITS 16
+#define ARENA_CHUNK      (1 << ARENA_CHUNK_BITS)   // elements per chunk
+#define ARENA_CHUNK_MASK (ARENA_CHUNK - 1)
+
+typedef struct arena {
+   size_t elemSize;
+   int nChunks;         // chunks[0..nChunks-1] are allocated
+   int chunksCap;
+   char **chunks;
+   uint32_t next;       // next handle to give out
+} Arena;
+
+Arena *arena_new(size_t elemSize);
+uint32_t arena_alloc(Arena *a);
+void arena_reset(Arena *a);
+void arena_free(Arena *a);
+int arena_write(const Arena *a, FILE *f);
+int arena_read(Arena *a, FILE *f);
+
+/*
+** Address of element h
+*/
+static inline void *
+arena_at(const Arena *a, uint32_t h) {
+   return a->chunks[h >> ARENA_CHUNK_BITS] + (size_t)(h & ARENA_CHUNK_MASK) * a->elemSize;
+}//arena_at()
+
+#endif
@@ -0,0 +1,399 @@
+/*
+** Benchmarks of the hot kernels on a scaled down retina.
+**
+** make bench builds the model with this main(). The grid is 20 mm at
+** BENCH_PPM pixels per mm unless PIXELS_PER_MM is set with -p.
+** Everything is deterministic for a given SEED and parameters:
+**
+**    find_density      at uniform random points of the 20 mm square
+**    density_row       rows of BENCH_ROW points of the same
+**    init_cells        placing (and sorting) every cell
+**    init_scanPoints   the search offsets, computed (and from the -s cache)
+**    grow              a forest of paths for the first -g fraction of cells
+**    findClosestCompleted_restrictedArea, makeOnePath and findNewPath
+**                      for the next -n cells each, against that forest
+**
+** For each kernel it reports the calls, the time they took, calls per
+** second and the latency of a call (mean and percentiles; cheap calls are
+** timed BENCH_BATCH at a time) to stderr, and as JSON to stdout or -o file.
+**
+** Usage: bench [-p NAME=value]... [-o file] [-n calls] [-g fraction] [-s dir]
+**
+** DENSE_SCALE is BENCH_DENSE_SCALE and SEED is BENCH_SEED unless set with -p.
+*/
+
+#define _POSIX_C_SOURCE 200809L   // for clock_gettime() under -std=c99
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <time.h>
+#include <glib.h>
+#include "setup.h"
+#include "density.h"
+#include "types.h"
+#include "grid.h"
+#include "cells.h"
+#include "spatial.h"
+#include "scan.h"
+#include "sector.h"
+#include "params.h"
+#include "rng.h"
+#include "pool.h"
+#include "main.h"
+
+#define BENCH_PPM         100
+#define BENCH_DENSE_SCALE 0.05    // so a BENCH_PPM retina is not full of cells
+#define BENCH_SEED        1
+#define BENCH_CALLS       20000   // default -n
+#define BENCH_GROWN       0.5     // default -g
+#define BENCH_DENSITY     (1 << 20) // find_density() calls
+#define BENCH_ROW         256     // points in each density_row()
+#define BENCH_BATCH       64      // calls timed together when one is too quick to time
+#define BENCH_REPS        5       // of init_cells() and init_scanPoints()
+
+typedef struct benchTimes {
+   const char *name;
+   long calls;
+   int per;             // calls in each sample
+   int n, cap;
+   double *t;           // seconds of each sample
+} BenchTimes;
+
+static FILE *json;
+static int nKernels;     // written to json so far
+
+static double
+now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}//now()
+
+static void
+times_init(BenchTimes *b, const char *name, int per) {
+   b->name  = name;
+   b->calls = 0;
+   b->per   = per;
+   b->n     = 0;
+   b->cap   = 0;
+   b->t     = NULL;
+}//times_init()
+
+/*
+** Add a sample of calls calls that took t seconds.
+*/
+static void
+times_add(BenchTimes *b, double t, int calls) {
+   if (b->n == b->cap) {
+      b->cap = b->cap == 0 ? 1024 : 2 * b->cap;
+      b->t = (double *)realloc(b->t, sizeof(double) * b->cap);
+      assert(b->t != NULL);
+   }
+   b->t[b->n++] = t;
+   b->calls += calls;
+}//times_add()
+
+static int
+cmp_double(const void *a, const void *b) {
+   double x = *(const double *)a, y = *(const double *)b;
+   return x < y ? -1 : x > y;
+}//cmp_double()
+
+/*
+** Latency (seconds per call) at fraction q of the sorted samples.
+*/
+static double
+percentile(const BenchTimes *b, double q) {
+   int k = (int)ceil(q * b->n) - 1;
+   if (k < 0)
+      k = 0;
+   return b->t[k] / b->per;
+}//percentile()
+
+/*
+** Report b to stderr and json, and free its samples.
+*/
+static void
+times_report(BenchTimes *b) {
+   double total = 0;
+   for(int k = 0 ; k < b->n ; k++)
+      total += b->t[k];
+   qsort(b->t, b->n, sizeof(double), cmp_double);
+
+   double mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0, rate = 0;
+   if (b->calls > 0) {
+      mean = total / b->calls;
+      p50  = percentile(b, 0.50);
+      p90  = percentile(b, 0.90);
+      p99  = percentile(b, 0.99);
+      max  = b->t[b->n - 1] / b->per;
+      rate = total > 0 ? b->calls / total : 0;
+   }
+   fprintf(stderr, "%-38s %9ld calls %10.4f s %12.0f /s  p50 %10.0f ns  p99 %10.0f ns\n",
+      b->name, b->calls, total, rate, p50 * 1e9, p99 * 1e9);
+
+   fprintf(json, "%s\n    {\"name\": \"%s\", \"calls\": %ld, \"seconds\": %.9f, \"per_second\": %.3f,\n",
+      nKernels++ == 0 ? "" : ",", b->name, b->calls, total, rate);
+   fprintf(json, "     \"latency_ns\": {\"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}}",
+      mean * 1e9, p50 * 1e9, p90 * 1e9, p99 * 1e9, max * 1e9);
+   free(b->t);
+}//times_report()
+
+/*
+** find_density() and density_row() at random points of the 20 mm square.
+*/
+static void
+bench_density() {
+   RngStream rng;
+   rng_stream_init(&rng, SEED, 0, 0, RNG_BENCH);
+   double half = (double)SIZE / 2.0 / PIXELS_PER_MM;
+   double *x = (double *)malloc(sizeof(double) * BENCH_DENSITY);
+   double *y = (double *)malloc(sizeof(double) * BENCH_DENSITY);
+   double *d = (double *)malloc(sizeof(double) * BENCH_ROW);
+   double *err = (double *)malloc(sizeof(double) * BENCH_ROW);
+   assert(x != NULL && y != NULL && d != NULL && err != NULL);
+   for(int i = 0 ; i < BENCH_DENSITY ; i++) {
+      x[i] = (2 * rng_uniform(&rng) - 1) * half;
+      y[i] = (2 * rng_uniform(&rng) - 1) * half;
+   }
+   volatile double sink = 0;   // so the calls are not optimised away
+
+   BenchTimes b;
+   times_init(&b, "find_density", BENCH_BATCH);
+   for(int i = 0 ; i < BENCH_DENSITY ; i += BENCH_BATCH) {
+      double t = now(), sum = 0;
+      for(int j = i ; j < i + BENCH_BATCH ; j++)
+         sum += find_density(x[j], y[j]);
+      times_add(&b, now() - t, BENCH_BATCH);
+      sink += sum;
+   }
+   times_report(&b);
+
+   density_init(sqrt(2.0) * half + 1);
+   times_init(&b, "density_row", 1);
+   for(int i = 0 ; i + BENCH_ROW <= BENCH_DENSITY ; i += BENCH_ROW) {
+      double t = now();
+      density_row(x[i], y + i, BENCH_ROW, d, err);
+      times_add(&b, now() - t, 1);
+      sink += d[0];
+   }
+   times_report(&b);
+
+   free(x);
+   free(y);
+   free(d);
+   free(err);
+}//bench_density()
+
+/*
+** init_cells() BENCH_REPS times on *grid (made if NULL).
+*/
+static void
+bench_init_cells(int *size, Grid **grid) {
+   BenchTimes b;
+   times_init(&b, "init_cells", 1);
+   for(int r = 0 ; r < BENCH_REPS ; r++) {
+      init_grid(size, grid);
+      double t = now();
+      init_cells();
+      times_add(&b, now() - t, 1);
+   }
+   times_report(&b);
+   cells_reset();
+}//bench_init_cells()
+
+/*
+** init_scanPoints() BENCH_REPS times without a cache, then (if cacheDir is
+** not NULL) BENCH_REPS times from one, leaving scanPoints made.
+*/
+static void
+bench_scan(const char *cacheDir) {
+   BenchTimes b;
+   times_init(&b, "init_scanPoints", 1);
+   scanCacheDir = NULL;
+   for(int r = 0 ; r < BENCH_REPS ; r++) {
+      if (r > 0)
+         scan_points_free();
+      double t = now();
+      init_scanPoints();
+      times_add(&b, now() - t, 1);
+   }
+   times_report(&b);
+
+   if (cacheDir == NULL)
+      return;
+   scanCacheDir = cacheDir;
+   scan_points_free();
+   init_scanPoints();      // make sure the cache is there
+   times_init(&b, "init_scanPoints_cached", 1);
+   for(int r = 0 ; r < BENCH_REPS ; r++) {
+      scan_points_free();
+      double t = now();
+      init_scanPoints();
+      times_add(&b, now() - t, 1);
+   }
+   times_report(&b);
+}//bench_scan()
+
+/*
+** Grow the first grown cells of cellOrder into a forest of paths in whole.
+*/
+static void
+bench_grow(Sector *whole, int grown) {
+   BenchTimes b;
+   times_init(&b, "grow", 1);
+   int first = make_start_cells(whole);
+   for(int k = first ; k < grown ; k++) {
+      double t = now();
+      grow(k, whole, NULL);
+      times_add(&b, now() - t, 1);
+   }
+   times_report(&b);
+}//bench_grow()
+
+/*
+** findClosestCompleted_restrictedArea() for cellOrder[from..to-1], which
+** changes nothing.
+*/
+static void
+bench_closest(Sector *whole, int from, int to) {
+   BenchTimes b;
+   times_init(&b, "findClosestCompleted_restrictedArea", 1);
+   for(int k = from ; k < to ; k++) {
+      double t = now();
+      findClosestCompleted_restrictedArea(cellOrder[k], whole);
+      times_add(&b, now() - t, 1);
+   }
+   times_report(&b);
+}//bench_closest()
+
+/*
+** makeOnePath() for cellOrder[from..to-1] in order, with the rest of what
+** grow() does (untimed) so that each cell can join those before it.
+*/
+static void
+bench_make_path(Sector *whole, int from, int to) {
+   BenchTimes b;
+   times_init(&b, "makeOnePath", 1);
+   for(int k = from ; k < to ; k++) {
+      int i = cellOrder[k];
+      Cell *closest = findClosestCompleted(i, whole);
+      if (closest == NULL) {
+         cellBlock[i].status = CELL_NO_NEAR;
+         continue;
+      }
+      int inGrid = grid_get_id(whole->grid, cellBlock[i].p.x, cellBlock[i].p.y) == FIRST_CELL_ID + i;
+      double t = now();
+      int ok = makeOnePath(i, closest, whole, NULL);
+      times_add(&b, now() - t, 1);
+      if (ok) {
+         cellBlock[i].status = CELL_GROWN;
+         if (IS_ROOM(roomBlock + i) && inGrid)
+            spatial_insert(whole->spatial, cellBlock + i, FIRST_CELL_ID + i);
+      } else {
+         cellBlock[i].status = CELL_FAILED;
+         if (inGrid)
+            grid_set_id(whole->grid, cellBlock[i].p.x, cellBlock[i].p.y, GRID_EMPTY);
+      }
+   }
+   times_report(&b);
+}//bench_make_path()
+
+/*
+** findNewPath() from each of cellOrder[from..to-1] to its closest completed
+** cell, as if that cell's path had no room: a search for somewhere else to
+** join (which may make a fake cell).
+*/
+static void
+bench_new_path(Sector *whole, int from, int to) {
+   BenchTimes b;
+   times_init(&b, "findNewPath", 1);
+   for(int k = from ; k < to ; k++) {
+      int i = cellOrder[k];
+      Cell *closest = findClosestCompleted(i, whole);
+      if (closest == NULL)
+         continue;
+      sector_new_path(whole);
+      double t = now();
+      findNewPath(cellBlock + i, NODE(closest->path)->c, whole, NULL, 0);   // a path starts at its own cell
+      times_add(&b, now() - t, 1);
+   }
+   times_report(&b);
+}//bench_new_path()
+
+int
+main(int argc, char *argv[]) {
+   char *outName = NULL;
+   const char *cacheDir = NULL;
+   int calls = BENCH_CALLS;
+   double grownFrac = BENCH_GROWN;
+   int bad = 0;
+   params_default(&params);
+   params.pixelsPerMM = BENCH_PPM;
+   params.denseScale  = BENCH_DENSE_SCALE;
+   params.seed        = BENCH_SEED;
+   params_derive(&params);
+   for(int a = 1 ; a < argc && !bad ; a++) {
+      if (strcmp(argv[a], "-p") == 0 && a + 1 < argc)
+         bad = params_set(&params, argv[++a]) != 0;
+      else if (strcmp(argv[a], "-o") == 0 && a + 1 < argc)
+         outName = argv[++a];
+      else if (strcmp(argv[a], "-n") == 0 && a + 1 < argc)
+         bad = (calls = atoi(argv[++a])) <= 0;
+      else if (strcmp(argv[a], "-g") == 0 && a + 1 < argc) {
+         grownFrac = atof(argv[++a]);
+         bad = grownFrac < 0 || grownFrac > 1;
+      } else if (strcmp(argv[a], "-s") == 0 && a + 1 < argc)
+         cacheDir = argv[++a];
+      else
+         bad = 1;
+   }
+   if (bad || params.seed == 0) {
+      fprintf(stderr, "Usage: %s [-p NAME=value]... [-o file] [-n calls] [-g fraction] [-s dir]\n", argv[0]);
+      return 1;
+   }
+   json = stdout;
+   if (outName != NULL && (json = fopen(outName, "w")) == NULL) {
+      perror(outName);
+      return 1;
+   }
+
+   pool_start(params.threads);
+   cells_init();
+
+   int size;
+   Grid *grid = NULL;
+   Spatial *spatial;
+
+   fprintf(json, "{\"pixels_per_mm\": %d, \"size\": %d, \"seed\": %d, \"dense_scale\": %g, \"threads\": %d,\n",
+      PIXELS_PER_MM, SIZE, params.seed, DENSE_SCALE, params.threads);
+   fprintf(json, " \"kernels\": [");
+
+   bench_density();
+   bench_init_cells(&size, &grid);
+   bench_scan(cacheDir);
+   scanTable = scan_table_new(scanPoints, scanPointLen);
+   spatial   = spatial_new(grid, scanPoints, scanPointLen, (int)NEW_PATH_RADIUS_LIMIT);
+
+   Sector *whole = sector_new(NUM_ARENAS - 1, grid, spatial);
+   whole->out = NULL;
+   int grown = (int)(grownFrac * numCells);
+   int made  = grown + calls < numCells ? grown + calls : numCells;
+   int found = made + calls < numCells ? made + calls : numCells;
+   bench_grow(whole, grown);
+   bench_closest(whole, grown, made);
+   bench_make_path(whole, grown, made);
+   bench_new_path(whole, made, found);
+
+   fprintf(json, "\n ],\n \"cells\": %d, \"grown\": %d, \"scan_points\": %d}\n", numCells, grown, scanPointLen);
+   if (json != stdout)
+      fclose(json);
+
+   free(whole);
+   cells_free();
+   pool_stop();
+   return 0;
+}//main()
@@ -0,0 +1,76 @@
+/*
+** Arena backed storage for fake cells and path Nodes: see cells.h
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include "types.h"
+#include "arena.h"
+#include "cells.h"
+
+Arena *fakeCellArenas[NUM_ARENAS];
+Arena *fakeRoomArenas[NUM_ARENAS];
+Arena *nodeArenas[NUM_ARENAS];
+
+/*
+** Create the (empty) arenas. Call before any new_fake_cell() or new_node().
+*/
+void
+cells_init(void) {
+   for(int a = 0 ; a < NUM_ARENAS ; a++) {
+      fakeCellArenas[a] = arena_new(sizeof(Cell));
+      fakeRoomArenas[a] = arena_new(sizeof(CellRoom));
+      nodeArenas[a]     = arena_new(sizeof(Node));
+   }
+}//cells_init()
+
+/*
+** Drop every fake cell and Node in one go.
+*/
+void
+cells_free(void) {
+   for(int a = 0 ; a < NUM_ARENAS ; a++) {
+      arena_free(fakeCellArenas[a]);
+      arena_free(fakeRoomArenas[a]);
+      arena_free(nodeArenas[a]);
+      fakeCellArenas[a] = fakeRoomArenas[a] = nodeArenas[a] = NULL;
+   }
+}//cells_free()
+
+/*
+** Drop every fake cell and Node, keeping the arenas' memory for reuse.
+*/
+void
+cells_reset(void) {
+   for(int a = 0 ; a < NUM_ARENAS ; a++) {
+      arena_reset(fakeCellArenas[a]);
+      arena_reset(fakeRoomArenas[a]);
+      arena_reset(nodeArenas[a]);
+   }
+}//cells_reset()
+
+/*
+** Make a new (uninitialised) fake cell, and its CellRoom, in arena and return its id.
+*/
+CellId
+new_fake_cell(int arena) {
+   uint32_t h = arena_alloc(fakeCellArenas[arena]);
+   uint32_t r = arena_alloc(fakeRoomArenas[arena]);
+   assert(h <= FAKE_MASK && r == h);
+   return FAKE_CELL_ID(arena, h);
+}//new_fake_cell()
+
+/*
+** Make a new Node in nodeArenas[arena] for cell c followed by next,
+** and return its handle.
+*/
+NodeId
+new_node(int arena, CellId c, NodeId next) {
+   uint32_t a = arena_alloc(nodeArenas[arena]);
+   assert(a <= NODE_MASK);
+   NodeId h = (uint32_t)((uint64_t)arena << NODE_SHIFT) | a;
+   Node *n = NODE(h);
+   n->c    = c;
+   n->next = next;
+   return h;
+}//new_node()
@@ -0,0 +1,100 @@
+#ifndef _CELLS_H_
+#define _CELLS_H_
+
+#include "types.h"
+#include "arena.h"
+
+/*
+** Storage for cells and path nodes, both addressed by 32-bit ids.
+**
+**   CellId: FIRST_CELL_ID + i is cellBlock[i] and roomBlock[i] (real cells),
+**           higher ids are fake waypoint cells made by findNewPath, kept in
+**           fakeCellArenas and fakeRoomArenas (CELL() and ROOM() of an id).
+**           cellBlock is in Morton order of the cells' pixels (so neighbours
+**           on the retina are neighbours in memory); cellOrder gives the
+**           order they grow in (see init_cells()).
+**   NodeId: handle into nodeArenas.
+**
+** There is one set of arenas per sector (see sector.h) so sectors can grow
+** at the same time; the arena is in the top SECTOR_BITS of a NodeId and of
+** a fake cell's index (id - FIRST_CELL_ID - numCells). Without -DSECTORS
+** there is one pair and SECTOR_BITS is 0.
+**
+** Ids below FIRST_CELL_ID and NodeId 0 are reserved (see NO_CELL, NO_NODE).
+*/
+
+#define NO_CELL       0  // also GRID_EMPTY
+#define FIRST_CELL_ID 2  // 1 is GRID_BLOCKED
+#define NO_NODE       0
+
+#ifndef SECTORS
+#define SECTORS 1
+#endif
+
+#if SECTORS > 1
+#define SECTOR_BITS 4
+#define NUM_ARENAS  (SECTORS + 1)   // one per sector, and one for sectors_merge()
+#else
+#define SECTOR_BITS 0
+#define NUM_ARENAS  1
+#endif
+#if NUM_ARENAS > (1 << SECTOR_BITS)
+#error "too many SECTORS"
+#endif
+
+#define NODE_SHIFT (32 - SECTOR_BITS)   // NodeId is arena << NODE_SHIFT | handle
+#define FAKE_SHIFT (31 - SECTOR_BITS)   // fake index is arena << FAKE_SHIFT | handle
+#define NODE_MASK  ((uint32_t)(((uint64_t)1 << NODE_SHIFT) - 1))
+#define FAKE_MASK  ((uint32_t)(((uint64_t)1 << FAKE_SHIFT) - 1))
+
+extern Cell *cellBlock;                   // from setup.c
+extern CellRoom *roomBlock;               // from setup.c
+extern int *cellOrder;                    // from setup.c
+extern int numCells;                      // from setup.c
+extern Arena *fakeCellArenas[NUM_ARENAS]; // fake cells...
+extern Arena *fakeRoomArenas[NUM_ARENAS]; // ...and their CellRooms, at the same handles
+extern Arena *nodeArenas[NUM_ARENAS];     // path Nodes
+
+void cells_init(void);
+void cells_free(void);
+void cells_reset(void);
+CellId new_fake_cell(int arena);
+NodeId new_node(int arena, CellId c, NodeId next);
+
+   // id of the fake cell with handle _h in fakeCellArenas[_a]
+#define FAKE_CELL_ID(_a, _h) (FIRST_CELL_ID + numCells + ((uint32_t)(_a) << FAKE_SHIFT | (_h)))
+
+#define NODE(_h) ((Node *)arena_at(nodeArenas[(uint64_t)(_h) >> NODE_SHIFT], (_h) & NODE_MASK))
+
+/*
+** Map a (non-reserved) id back to its Cell.
+*/
+static inline Cell *
+cell_from_id(CellId id) {
+   unsigned int i = id - FIRST_CELL_ID;
+   if (i < (unsigned int)numCells)
+      return cellBlock + i;
+   i -= numCells;
+   return (Cell *)arena_at(fakeCellArenas[i >> FAKE_SHIFT], i & FAKE_MASK);
+}//cell_from_id()
+
+#define CELL(_id) cell_from_id(_id)
+
+/*
+** Map a (non-reserved) id to its CellRoom.
+*/
+static inline CellRoom *
+room_from_id(CellId id) {
+   unsigned int i = id - FIRST_CELL_ID;
+   if (i < (unsigned int)numCells)
+      return roomBlock + i;
+   i -= numCells;
+   return (CellRoom *)arena_at(fakeRoomArenas[i >> FAKE_SHIFT], i & FAKE_MASK);
+}//room_from_id()
+
+#define ROOM(_id) room_from_id(_id)
+
+   // can another path go through the cell with CellRoom _r
+#define IS_ROOM(_r) ((_r)->count < (_r)->thickness || (_r)->thickness == THICK_UNLIMITED)
+
+#endif
@@ -0,0 +1,352 @@
+/*
+** Regression checks of kernels whose answers must not change.
+**
+** make check builds the model with this main() and runs it:
+**
+**    radix     radix_sort_PointD() against qsort() with cmp_PointD() on
+**              points with ties, negative coordinates and distances, and -0,
+**              and radix_sort_uint64() against qsort(), in one part and in
+**              parallel parts (keys sharing digits, so passes are skipped)
+**    philox    philox() against the Philox4x32-10 known answers of Random123
+**    pool      many pool_for() calls of uneven tasks, each index done once,
+**              by a worker in range that is running no other task
+**    queue     3 producers and 3 consumers mixing single and batch calls on
+**              queues of 2, 8 and 64 slots: every item arrives once, and
+**              each producer's items reach each consumer in order
+**
+** Each check prints a line to stderr; the exit status is the number of
+** checks that failed.
+**
+** Usage: check [-p THREADS=n]
+**
+** With no THREADS (or 0) the pool has 3 threads, so the parallel paths run.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <glib.h>
+#include "setup.h"
+#include "types.h"
+#include "params.h"
+#include "rng.h"
+#include "radix.h"
+#include "pool.h"
+#include "queue.h"
+
+#define CHECK_SEED  1
+#define CHECK_BIG   100000    // elements, enough for a part per worker (see radix_sort())
+#define CHECK_JOBS  2000      // pool_for() calls of the pool check
+#define CHECK_MAX_N 5000      // ... each of up to this many tasks
+#define CHECK_SIDE  3         // producers, and consumers, of the queue check
+#define CHECK_ITEMS 50000     // ... put by each producer
+#define CHECK_BATCH 16        // most items in one insert_many() or remove_many()
+
+static int
+cmp_uint64(const void *a, const void *b) {
+   uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+   return x < y ? -1 : (x > y ? +1 : 0);
+}//cmp_uint64()
+
+/*
+** n PointDs from s, drawn from few values so there are many ties.
+*/
+static void
+make_points(PointD *a, int n, RngStream *s) {
+   static const float dists[] = {0.0f, -0.0f, 1.0f, 1.5f, -2.0f, 1e-30f, -1e-30f, 3e5f};
+   for(int i = 0 ; i < n ; i++) {
+      a[i].dist = dists[(int)(rng_uniform(s) * 8)];
+      a[i].p.x  = (short)(rng_uniform(s) * 16) - 8;
+      a[i].p.y  = (short)(rng_uniform(s) * 6000) - 3000;
+   }
+}//make_points()
+
+/*
+** Return 1 if the same in the order of cmp_PointD() (so -0 and 0 are the same).
+*/
+static int
+same_points(const PointD *a, const PointD *b, int n) {
+   for(int i = 0 ; i < n ; i++)
+      if (cmp_PointD(a + i, b + i) != 0)
+         return 0;
+   return 1;
+}//same_points()
+
+static int
+check_radix() {
+   static const int sizes[] = {0, 1, 2, 3, 255, 256, 4097, CHECK_BIG};
+   PointD *pa = (PointD *)malloc(sizeof(PointD) * CHECK_BIG);
+   PointD *pb = (PointD *)malloc(sizeof(PointD) * CHECK_BIG);
+   uint64_t *ka = (uint64_t *)malloc(sizeof(uint64_t) * CHECK_BIG);
+   uint64_t *kb = (uint64_t *)malloc(sizeof(uint64_t) * CHECK_BIG);
+   assert(pa != NULL && pb != NULL && ka != NULL && kb != NULL);
+   RngStream s;
+   rng_stream_init(&s, CHECK_SEED, 0, 0, RNG_CHECK);
+
+   int bad = 0;
+   for(int k = 0 ; k < (int)(sizeof(sizes) / sizeof(sizes[0])) ; k++)
+      for(int parallel = 0 ; parallel < 2 ; parallel++) {
+         int n = sizes[k];
+         make_points(pa, n, &s);
+         memcpy(pb, pa, sizeof(PointD) * n);
+         radix_sort_PointD(pa, n, parallel);
+         qsort(pb, n, sizeof(PointD), cmp_PointD);
+         if (!same_points(pa, pb, n)) {
+            fprintf(stderr, "radix: PointD n=%d parallel=%d differs from qsort\n", n, parallel);
+            bad = 1;
+         }
+
+            // only the low 20 and top 4 bits vary, so most digits are shared
+         for(int i = 0 ; i < n ; i++)
+            ka[i] = ((uint64_t)(rng_uniform(&s) * 16) << 60) | (uint64_t)(rng_uniform(&s) * (1 << 20)) | 0x0123456789000000ull;
+         memcpy(kb, ka, sizeof(uint64_t) * n);
+         radix_sort_uint64(ka, n, parallel);
+         qsort(kb, n, sizeof(uint64_t), cmp_uint64);
+         if (memcmp(ka, kb, sizeof(uint64_t) * n) != 0) {
+            fprintf(stderr, "radix: uint64 n=%d parallel=%d differs from qsort\n", n, parallel);
+            bad = 1;
+         }
+      }
+
+   free(pa);
+   free(pb);
+   free(ka);
+   free(kb);
+   return bad;
+}//check_radix()
+
+static int
+check_philox() {
+   static const struct {
+      uint32_t ctr[4], key[2], out[4];
+   } known[] = {   // kat_vectors of Random123 1.09
+      {{0x00000000, 0x00000000, 0x00000000, 0x00000000}, {0x00000000, 0x00000000},
+       {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+      {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff},
+       {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+      {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0},
+       {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+   };
+   int bad = 0;
+   for(int k = 0 ; k < (int)(sizeof(known) / sizeof(known[0])) ; k++) {
+      uint32_t out[4];
+      philox(known[k].ctr, known[k].key, out);
+      if (memcmp(out, known[k].out, sizeof(out)) != 0) {
+         fprintf(stderr, "philox: answer %d is %08x %08x %08x %08x\n", k, out[0], out[1], out[2], out[3]);
+         bad = 1;
+      }
+   }
+   return bad;
+}//check_philox()
+
+typedef struct poolCheck {
+   volatile gint *done;    // done[i] counts the runs of task i
+   volatile gint *inUse;   // inUse[w] is 1 while worker w runs a task
+   int nWorkers;
+   volatile gint bad;
+} PoolCheck;
+
+/*
+** Pool task: count i, after some work that grows with i % 64 so the shares
+** are uneven and workers steal.
+*/
+static void
+pool_task(void *arg, int i, int worker) {
+   PoolCheck *c = (PoolCheck *)arg;
+   if (worker < 0 || worker >= c->nWorkers || !g_atomic_int_compare_and_exchange(c->inUse + worker, 0, 1)) {
+      g_atomic_int_set(&c->bad, 1);
+      return;
+   }
+   volatile double x = 0;
+   for(int k = 0 ; k < (i % 64) * 4 ; k++)
+      x += k;
+   g_atomic_int_inc(c->done + i);
+   g_atomic_int_set(c->inUse + worker, 0);
+}//pool_task()
+
+static int
+check_pool() {
+   PoolCheck c;
+   c.nWorkers = pool_workers();
+   c.done  = (volatile gint *)calloc(CHECK_MAX_N, sizeof(gint));
+   c.inUse = (volatile gint *)calloc(c.nWorkers, sizeof(gint));
+   assert(c.done != NULL && c.inUse != NULL);
+   c.bad = 0;
+   RngStream s;
+   rng_stream_init(&s, CHECK_SEED, 1, 0, RNG_CHECK);
+
+   int bad = 0;
+   for(int j = 0 ; j < CHECK_JOBS && !bad ; j++) {
+      int n = j < 8 ? j : (int)(rng_uniform(&s) * CHECK_MAX_N);   // the small cases too
+      pool_for(n, pool_task, &c);
+      for(int i = 0 ; i < CHECK_MAX_N ; i++)
+         if (c.done[i] != (i < n)) {
+            fprintf(stderr, "pool: job %d of %d tasks ran task %d %d times\n", j, n, i, c.done[i]);
+            bad = 1;
+            break;
+         }
+      if (c.bad) {
+         fprintf(stderr, "pool: job %d of %d tasks had a bad or busy worker\n", j, n);
+         bad = 1;
+      }
+      memset((void *)c.done, 0, sizeof(gint) * CHECK_MAX_N);
+   }
+
+   free((void *)c.done);
+   free((void *)c.inUse);
+   return bad;
+}//check_pool()
+
+typedef struct queueCheck {
+   Queue *q;
+   volatile gint *got;     // got[item] counts its removals
+   volatile gint producing;   // producers not yet done
+   volatile gint bad;
+} QueueCheck;
+
+typedef struct queueThread {
+   QueueCheck *c;
+   int id;
+} QueueThread;
+
+   // item k of producer p, as a pointer that is never NULL
+#define ITEM(_p, _k)     ((void *)(long)((_p) * CHECK_ITEMS + (_k) + 1))
+#define ITEM_INDEX(_v)   ((int)(long)(_v) - 1)
+
+static gpointer
+producer(gpointer data) {
+   QueueThread *t = (QueueThread *)data;
+   RngStream s;
+   rng_stream_init(&s, CHECK_SEED, 2, t->id, RNG_CHECK);
+   void *items[CHECK_BATCH];
+   for(int k = 0 ; k < CHECK_ITEMS ; ) {
+      int n = 1 + (int)(rng_uniform(&s) * CHECK_BATCH);
+      n = min(n, CHECK_ITEMS - k);
+      if (n == 1)
+         insert_last(t->c->q, ITEM(t->id, k++));
+      else {
+         for(int j = 0 ; j < n ; j++)
+            items[j] = ITEM(t->id, k++);
+         insert_many(t->c->q, items, n);
+      }
+   }
+   g_atomic_int_add(&t->c->producing, -1);
+   return NULL;
+}//producer()
+
+static gpointer
+consumer(gpointer data) {
+   QueueThread *t = (QueueThread *)data;
+   QueueCheck *c = t->c;
+   RngStream s;
+   rng_stream_init(&s, CHECK_SEED, 3, t->id, RNG_CHECK);
+   int last[CHECK_SIDE];   // of each producer's items seen here
+   for(int p = 0 ; p < CHECK_SIDE ; p++)
+      last[p] = -1;
+   void *items[CHECK_BATCH];
+   for(;;) {
+      int done = g_atomic_int_get(&c->producing) == 0;   // before the remove, so nothing comes after it
+      int max = 1 + (int)(rng_uniform(&s) * CHECK_BATCH);
+      int n;
+      if (max == 1)
+         n = (items[0] = remove_first(c->q)) != NULL;
+      else
+         n = remove_many(c->q, items, max);
+      if (n == 0) {
+         if (done)
+            break;
+         g_thread_yield();
+         continue;
+      }
+      for(int j = 0 ; j < n ; j++) {
+         int i = ITEM_INDEX(items[j]);
+         if (i < 0 || i >= CHECK_SIDE * CHECK_ITEMS || i % CHECK_ITEMS <= last[i / CHECK_ITEMS]) {
+            g_atomic_int_set(&c->bad, 1);
+            continue;
+         }
+         last[i / CHECK_ITEMS] = i % CHECK_ITEMS;
+         g_atomic_int_inc(c->got + i);
+      }
+   }
+   return NULL;
+}//consumer()
+
+static int
+check_queue() {
+   static const int capacities[] = {2, 8, 64};
+   QueueCheck c;
+   c.got = (volatile gint *)malloc(sizeof(gint) * CHECK_SIDE * CHECK_ITEMS);
+   assert(c.got != NULL);
+
+   int bad = 0;
+   for(int k = 0 ; k < (int)(sizeof(capacities) / sizeof(capacities[0])) ; k++) {
+      c.q = new_queue(capacities[k]);
+      memset((void *)c.got, 0, sizeof(gint) * CHECK_SIDE * CHECK_ITEMS);
+      c.producing = CHECK_SIDE;
+      c.bad = 0;
+      QueueThread t[2 * CHECK_SIDE];
+      GThread *threads[2 * CHECK_SIDE];
+      for(int i = 0 ; i < 2 * CHECK_SIDE ; i++) {
+         t[i].c  = &c;
+         t[i].id = i % CHECK_SIDE;
+         threads[i] = g_thread_new("check", i < CHECK_SIDE ? producer : consumer, t + i);
+      }
+      for(int i = 0 ; i < 2 * CHECK_SIDE ; i++)
+         g_thread_join(threads[i]);
+
+      if (c.bad) {
+         fprintf(stderr, "queue: capacity %d gave an item out of order or not put\n", capacities[k]);
+         bad = 1;
+      }
+      for(int i = 0 ; i < CHECK_SIDE * CHECK_ITEMS ; i++)
+         if (c.got[i] != 1) {
+            fprintf(stderr, "queue: capacity %d gave item %d %d times\n", capacities[k], i, c.got[i]);
+            bad = 1;
+            break;
+         }
+      if (queue_count(c.q) != 0 || remove_first(c.q) != NULL) {
+         fprintf(stderr, "queue: capacity %d not empty at the end\n", capacities[k]);
+         bad = 1;
+      }
+      free_queue(c.q);
+   }
+
+   free((void *)c.got);
+   return bad;
+}//check_queue()
+
+int
+main(int argc, char *argv[]) {
+   params_default(&params);
+   int bad = 0;
+   for(int a = 1 ; a < argc && !bad ; a++)
+      if (strcmp(argv[a], "-p") == 0 && a + 1 < argc)
+         bad = params_set(&params, argv[++a]) != 0;
+      else
+         bad = 1;
+   if (bad) {
+      fprintf(stderr, "Usage: %s [-p THREADS=n]\n", argv[0]);
+      return 1;
+   }
+   pool_start(params.threads > 0 ? params.threads : 3);
+
+   struct {
+      const char *name;
+      int (*check)();
+   } checks[] = {
+      {"radix", check_radix},
+      {"philox", check_philox},
+      {"pool", check_pool},
+      {"queue", check_queue},
+   };
+   int failed = 0;
+   for(int c = 0 ; c < (int)(sizeof(checks) / sizeof(checks[0])) ; c++) {
+      int f = checks[c].check();
+      fprintf(stderr, "%-8s %s\n", checks[c].name, f ? "FAILED" : "ok");
+      failed += f != 0;
+   }
+
+   pool_stop();
+   return failed;
+}//main()
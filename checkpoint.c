@@ -0,0 +1,175 @@
+/*
+** Checkpoints of a growth run: see checkpoint.h
+*/
+
+#define _POSIX_C_SOURCE 200809L   // for fileno() and ftruncate() under -std=c99
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include "setup.h"
+#include "density.h"
+#include "types.h"
+#include "grid.h"
+#include "cells.h"
+#include "arena.h"
+#include "checkpoint.h"
+
+/*
+** Fill h for this build.
+*/
+static void
+header_init(CkHeader *h) {
+   memset(h, 0, sizeof(*h));
+   memcpy(h->magic, CK_MAGIC, sizeof(h->magic));
+   h->version     = CK_VERSION;
+   h->cellSize    = sizeof(Cell);
+   h->roomSize    = sizeof(CellRoom);
+   h->size        = SIZE;
+   h->pixelsPerMM = PIXELS_PER_MM;
+   h->sectors     = SECTORS;
+   h->numArenas   = NUM_ARENAS;
+   h->params      = params;
+}//header_init()
+
+/*
+** Save the state of growth, with cellBlock[cellOrder[next]] the next cell to grow,
+** to file name, noting the lengths of the report and progress file (-1 if not
+** known). Returns 0, or -1 (with errno set) if it could not be written.
+*/
+int
+checkpoint_write(const char *name, const Grid *grid, int next, long reportLength, long progressLength) {
+   char *tmp = (char *)malloc(strlen(name) + 5);
+   assert(tmp != NULL);
+   sprintf(tmp, "%s.tmp", name);
+
+   FILE *f = fopen(tmp, "wb");
+   if (f == NULL) {
+      free(tmp);
+      return -1;
+   }
+   setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+   CkHeader h;
+   header_init(&h);
+   h.numCells = numCells;
+   h.next     = next;
+   h.reportLength   = reportLength;
+   h.progressLength = progressLength;
+
+   int result = 0;
+   if (fwrite(&h, sizeof(h), 1, f) != 1
+   ||  fwrite(cellBlock, sizeof(Cell), numCells, f) != (size_t)numCells
+   ||  fwrite(roomBlock, sizeof(CellRoom), numCells, f) != (size_t)numCells
+   ||  fwrite(cellOrder, sizeof(int), numCells, f) != (size_t)numCells)
+      result = -1;
+   for(int a = 0 ; a < NUM_ARENAS && result == 0 ; a++)
+      if (arena_write(fakeCellArenas[a], f) != 0 || arena_write(fakeRoomArenas[a], f) != 0
+      ||  arena_write(nodeArenas[a], f) != 0)
+         result = -1;
+   if (result == 0 && grid_write(grid, f) != 0)
+      result = -1;
+   if (fclose(f) != 0)
+      result = -1;
+   if (result == 0 && rename(tmp, name) != 0)
+      result = -1;
+   if (result != 0)
+      remove(tmp);
+
+   free(tmp);
+   return result;
+}//checkpoint_write()
+
+/*
+** Read back a checkpoint written by this build: sets params (but for
+** threads), cellBlock, roomBlock, cellOrder, numCells, the (empty, see cells_init()) arenas, *grid,
+** *next, and the lengths of the report and progress file when it was written.
+** Every cell is left out of the spatial index (see spatial_rebuild()),
+** and unmarked (see sector.h).
+** Returns 0, or -1 (with errno set) if the file cannot be used.
+*/
+int
+checkpoint_read(const char *name, Grid **grid, int *next, long *reportLength, long *progressLength) {
+   FILE *f = fopen(name, "rb");
+   if (f == NULL)
+      return -1;
+   setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+   CkHeader h, want;
+   header_init(&want);
+   if (fread(&h, sizeof(h), 1, f) != 1
+   ||  memcmp(h.magic, want.magic, sizeof(h.magic)) != 0
+   ||  h.version != want.version || h.cellSize != want.cellSize || h.roomSize != want.roomSize
+   ||  h.pixelsPerMM != h.params.pixelsPerMM || h.size != SIZE_MM * h.pixelsPerMM
+   ||  h.sectors != want.sectors || h.numArenas != want.numArenas
+   ||  h.numCells <= 0 || h.next <= 0 || h.next > h.numCells) {
+      fclose(f);
+      errno = EINVAL;
+      return -1;
+   }
+
+   numCells  = h.numCells;
+   cellBlock = (Cell *)malloc(sizeof(Cell) * numCells);
+   roomBlock = (CellRoom *)malloc(sizeof(CellRoom) * numCells);
+   cellOrder = (int *)malloc(sizeof(int) * numCells);
+   assert(cellBlock != NULL && roomBlock != NULL && cellOrder != NULL);
+   int ok = fread(cellBlock, sizeof(Cell), numCells, f) == (size_t)numCells
+         && fread(roomBlock, sizeof(CellRoom), numCells, f) == (size_t)numCells
+         && fread(cellOrder, sizeof(int), numCells, f) == (size_t)numCells;
+   for(int a = 0 ; a < NUM_ARENAS && ok ; a++)
+      ok = arena_read(fakeCellArenas[a], f) == 0 && arena_read(fakeRoomArenas[a], f) == 0
+        && arena_read(nodeArenas[a], f) == 0;
+   if (ok)
+      ok = (*grid = grid_read(f)) != NULL;
+   fclose(f);
+   if (!ok) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   for(int i = 0 ; i < numCells ; i++) {
+      cellBlock[i].slot = -1;
+      roomBlock[i].mark = 0;
+   }
+   for(int a = 0 ; a < NUM_ARENAS ; a++)
+      for(uint32_t k = 1 ; k < fakeCellArenas[a]->next ; k++) {
+         ((Cell *)arena_at(fakeCellArenas[a], k))->slot = -1;
+         ((CellRoom *)arena_at(fakeRoomArenas[a], k))->mark = 0;
+      }
+
+   int threads    = params.threads;
+   params         = h.params;
+   params.threads = threads;
+   *next = h.next;
+   *reportLength   = (long)h.reportLength;
+   *progressLength = (long)h.progressLength;
+   return 0;
+}//checkpoint_read()
+
+/*
+** Open file name, of the run being resumed, to carry on writing after its
+** first length bytes, cutting off the rest. If length < 0 (not known), just
+** add to the end of it. Returns the file, or NULL (with errno set) if it
+** cannot be opened or is shorter than length.
+*/
+FILE *
+checkpoint_reopen(const char *name, long length) {
+   if (length < 0)
+      return fopen(name, "a");
+   FILE *f = fopen(name, "r+");
+   if (f == NULL)
+      return NULL;
+   if (fseek(f, 0, SEEK_END) != 0 || ftell(f) < length) {
+      fclose(f);
+      errno = EINVAL;
+      return NULL;
+   }
+   if (ftruncate(fileno(f), (off_t)length) != 0 || fseek(f, length, SEEK_SET) != 0) {
+      fclose(f);
+      return NULL;
+   }
+   return f;
+}//checkpoint_reopen()
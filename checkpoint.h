@@ -0,0 +1,60 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "types.h"
+#include "grid.h"
+#include "params.h"
+
+/*
+** Saving a run part way through process() so it can be carried on later
+** (stack -k file [--resume]).
+**
+** A checkpoint holds the parameters (see params.h), cellBlock (including
+** paths and alternates), roomBlock (counts) and cellOrder, every fake cell
+** (and its CellRoom) and Node, the grid, and the next cell to grow. That is everything growth depends on: the random numbers
+** are only used to place the cells, and the spatial index is rebuilt from the
+** grid's room bits.
+** It is a raw dump, so it can only be read by a stack built the same way.
+**
+** The file is written to name.tmp and renamed over name, so a run killed
+** while writing leaves the previous checkpoint intact.
+** Once a run has finished and written all its output the checkpoint is
+** removed, so a later --resume in the same place fails rather than growing
+** the old run again.
+**
+** It also holds how long the report (-o file) and progress file (-t) were
+** when it was written. A resumed run reopens them with checkpoint_reopen(),
+** which cuts off whatever was written after the checkpoint, as it is about
+** to be written again.
+*/
+
+#ifndef CHECKPOINT_SECS
+#define CHECKPOINT_SECS (30 * 60)   // at most this often
+#endif
+
+#define CK_MAGIC   "STACKCK1"
+#define CK_VERSION 10
+
+typedef struct ckHeader {
+   char magic[8];
+   int version;
+   int cellSize;        // sizeof(Cell) and sizeof(CellRoom), and the build settings below, must match
+   int roomSize;
+   int size;            // (these two are of params, so come from the checkpoint)
+   int pixelsPerMM;
+   int sectors;
+   int numArenas;
+   Params params;       // of the run (THREADS is not restored)
+   int numCells;
+   int next;            // cellBlock[cellOrder[next]] is the next cell to grow
+   int64_t reportLength;   // bytes in the report...
+   int64_t progressLength; // ...and progress file, -1 if not known
+} CkHeader;
+
+int checkpoint_write(const char *name, const Grid *grid, int next, long reportLength, long progressLength);
+int checkpoint_read(const char *name, Grid **grid, int *next, long *reportLength, long *progressLength);
+FILE *checkpoint_reopen(const char *name, long length);
+
+#endif
@@ -7,6 +7,13 @@
 #define M_PI 3.14159265358979323846
 #endif
 
+   // lookup tables for density_row()
+#define DENSITY_STEP  (1.0/256.0)   // mm of eccentricity per table entry
+#define DENSITY_W_ERR 1e-5          // bound on error of the weight between axes (fraction of 90 degrees)
+
 double interp(double x1, double y1, double x2, double y2, double x);
 double get_density_axis(double *xs, double *ys, double x);
 double find_density(double x, double y);
+void density_init(double maxR);
+void density_row(double x, const double *y, int n, double *d, double *err);
+double density_max(double r0, double r1);
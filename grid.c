@@ -0,0 +1,252 @@
+/*
+** Sparse tiled grid: see grid.h
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "types.h"
+#include "grid.h"
+
+/*
+** Allocate an empty grid of size*size pixels. No tiles are allocated.
+*/
+Grid *
+grid_new(int size) {
+   Grid *g = (Grid *)malloc(sizeof(Grid));
+   assert(g != NULL);
+   g->size         = size;
+   g->tilesPerSide = (size + TILE_SIZE - 1) / TILE_SIZE;
+   g->tiles        = (Tile **)calloc((size_t)g->tilesPerSide * g->tilesPerSide, sizeof(Tile *));
+   assert(g->tiles != NULL);
+   g->log          = NULL;
+   return g;
+}//grid_new()
+
+/*
+** Release g and all its tiles (but not its log).
+*/
+void
+grid_free(Grid *g) {
+   for(int i = 0 ; i < g->tilesPerSide * g->tilesPerSide ; i++)
+      if (g->tiles[i] != NULL) {
+         free(g->tiles[i]->ids);
+         free(g->tiles[i]);
+      }
+   free(g->tiles);
+   free(g);
+}//grid_free()
+
+/*
+** Empty every pixel of g, keeping the tiles' memory for reuse.
+*/
+void
+grid_clear(Grid *g) {
+   for(int i = 0 ; i < g->tilesPerSide * g->tilesPerSide ; i++) {
+      Tile *t = g->tiles[i];
+      if (t == NULL)
+         continue;
+      memset(t->occupied, 0, sizeof(t->occupied));
+      memset(t->room, 0, sizeof(t->room));
+      memset(t->rank, 0, sizeof(t->rank));
+      t->len = 0;
+   }
+}//grid_clear()
+
+/*
+** Append (x,y) to g->log, if there is one.
+*/
+static inline void
+grid_log(Grid *g, int x, int y) {
+   GridLog *log = g->log;
+   if (log == NULL)
+      return;
+   if (log->len == log->cap) {
+      log->cap = log->cap == 0 ? 1024 : 2 * log->cap;
+      log->p = (Point *)realloc(log->p, sizeof(Point) * log->cap);
+      assert(log->p != NULL);
+   }
+   log->p[log->len].x = x;
+   log->p[log->len].y = y;
+   log->len++;
+}//grid_log()
+
+/*
+** Set (x,y) to id, allocating the tile if needed.
+** Setting GRID_EMPTY removes whatever is there (and never allocates).
+** Not thread safe if two threads touch the same tile.
+*/
+void
+grid_set_id(Grid *g, int x, int y, CellId id) {
+   Tile **tp = g->tiles + (x >> TILE_BITS) * g->tilesPerSide + (y >> TILE_BITS);
+   Tile *t = *tp;
+   if (t == NULL) {
+      if (id == GRID_EMPTY)
+         return;
+      t = (Tile *)calloc(1, sizeof(Tile));
+      assert(t != NULL);
+      *tp = t;
+   }
+
+   int lx = x & TILE_MASK;
+   uint64_t bit = (uint64_t)1 << (y & TILE_MASK);
+   int pos = t->rank[lx] + __builtin_popcountll(t->occupied[lx] & (bit - 1));
+
+   if (t->occupied[lx] & bit) {
+      grid_log(g, x, y);
+      if (id != GRID_EMPTY) {    // overwrite
+         t->ids[pos] = id;
+         return;
+      }
+                                 // remove
+      memmove(t->ids + pos, t->ids + pos + 1, sizeof(CellId) * (t->len - pos - 1));
+      t->len--;
+      t->occupied[lx] &= ~bit;
+      t->room[lx]     &= ~bit;
+      for(int i = lx + 1 ; i < TILE_SIZE ; i++)
+         t->rank[i]--;
+      return;
+   }
+
+   if (id == GRID_EMPTY)
+      return;
+
+   grid_log(g, x, y);
+   if (t->len == t->cap) {
+      t->cap = t->cap == 0 ? 16 : 2 * t->cap;
+      t->ids = (CellId *)realloc(t->ids, sizeof(CellId) * t->cap);
+      assert(t->ids != NULL);
+   }
+   memmove(t->ids + pos + 1, t->ids + pos, sizeof(CellId) * (t->len - pos));
+   t->ids[pos] = id;
+   t->len++;
+   t->occupied[lx] |= bit;
+   for(int i = lx + 1 ; i < TILE_SIZE ; i++)
+      t->rank[i]++;
+}//grid_set_id()
+
+/*
+** Set or clear the room bit for (x,y), which must be occupied.
+*/
+void
+grid_set_room(Grid *g, int x, int y, int room) {
+   Tile *t = g->tiles[(x >> TILE_BITS) * g->tilesPerSide + (y >> TILE_BITS)];
+   assert(t != NULL && TILE_BIT(t->occupied, x, y));
+   uint64_t bit = (uint64_t)1 << (y & TILE_MASK);
+   grid_log(g, x, y);
+   if (room)
+      t->room[x & TILE_MASK] |= bit;
+   else
+      t->room[x & TILE_MASK] &= ~bit;
+}//grid_set_room()
+
+/*
+** Remove every GRID_BLOCKED entry in one pass per tile (rather than one
+** memmove per pixel), freeing tiles that end up empty.
+*/
+void
+grid_clear_blocked(Grid *g) {
+   for(int i = 0 ; i < g->tilesPerSide * g->tilesPerSide ; i++) {
+      Tile *t = g->tiles[i];
+      if (t == NULL)
+         continue;
+
+      int in = 0, out = 0;
+      for(int lx = 0 ; lx < TILE_SIZE ; lx++) {
+         t->rank[lx] = out;
+         for(int ly = 0 ; ly < TILE_SIZE ; ly++) {
+            uint64_t bit = (uint64_t)1 << ly;
+            if (!(t->occupied[lx] & bit))
+               continue;
+            if (t->ids[in] == GRID_BLOCKED)
+               t->occupied[lx] &= ~bit;
+            else
+               t->ids[out++] = t->ids[in];
+            in++;
+         }
+      }
+      t->len = out;
+
+      if (t->len == 0) {
+         free(t->ids);
+         free(t);
+         g->tiles[i] = NULL;
+      }
+   }
+}//grid_clear_blocked()
+
+/*
+** Write the tiles of g (ids, occupied and room bits) to f.
+** Returns 0, or -1 on a write error.
+*/
+int
+grid_write(const Grid *g, FILE *f) {
+   int n = g->tilesPerSide * g->tilesPerSide;
+   int used = 0;
+   for(int i = 0 ; i < n ; i++)
+      used += g->tiles[i] != NULL;
+   if (fwrite(&g->size, sizeof(int), 1, f) != 1 || fwrite(&used, sizeof(int), 1, f) != 1)
+      return -1;
+   for(int i = 0 ; i < n ; i++) {
+      Tile *t = g->tiles[i];
+      if (t == NULL)
+         continue;
+      if (fwrite(&i, sizeof(int), 1, f) != 1
+      ||  fwrite(t->occupied, sizeof(t->occupied), 1, f) != 1
+      ||  fwrite(t->room, sizeof(t->room), 1, f) != 1
+      ||  fwrite(&t->len, sizeof(int), 1, f) != 1
+      ||  fwrite(t->ids, sizeof(CellId), t->len, f) != (size_t)t->len)
+         return -1;
+   }
+   return 0;
+}//grid_write()
+
+/*
+** Fill t (all zero) from f. Returns 0, or -1 if f is short or inconsistent.
+*/
+static int
+read_tile(Tile *t, FILE *f) {
+   if (fread(t->occupied, sizeof(t->occupied), 1, f) != 1
+   ||  fread(t->room, sizeof(t->room), 1, f) != 1
+   ||  fread(&t->len, sizeof(int), 1, f) != 1
+   ||  t->len < 0 || t->len > TILE_SIZE * TILE_SIZE)
+      return -1;
+   t->cap = t->len;
+   t->ids = (CellId *)malloc(sizeof(CellId) * (t->len > 0 ? t->len : 1));
+   assert(t->ids != NULL);
+   if (fread(t->ids, sizeof(CellId), t->len, f) != (size_t)t->len)
+      return -1;
+   int r = 0;
+   for(int lx = 0 ; lx < TILE_SIZE ; lx++) {
+      t->rank[lx] = r;
+      r += __builtin_popcountll(t->occupied[lx]);
+   }
+   return r == t->len ? 0 : -1;
+}//read_tile()
+
+/*
+** Make a grid from f (as written by grid_write()), or return NULL if f is
+** short or inconsistent.
+*/
+Grid *
+grid_read(FILE *f) {
+   int size, used;
+   if (fread(&size, sizeof(int), 1, f) != 1 || fread(&used, sizeof(int), 1, f) != 1 || size <= 0)
+      return NULL;
+   Grid *g = grid_new(size);
+   int n = g->tilesPerSide * g->tilesPerSide;
+   for(int k = 0 ; k < used ; k++) {
+      int i;
+      if (fread(&i, sizeof(int), 1, f) != 1 || i < 0 || i >= n || g->tiles[i] != NULL) {
+         grid_free(g);
+         return NULL;
+      }
+      g->tiles[i] = (Tile *)calloc(1, sizeof(Tile));
+      assert(g->tiles[i] != NULL);
+      if (read_tile(g->tiles[i], f) != 0) {
+         grid_free(g);
+         return NULL;
+      }
+   }
+   return g;
+}//grid_read()
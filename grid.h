@@ -0,0 +1,100 @@
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "types.h"
+#include "cells.h"
+
+/*
+** Sparse tiled grid of cell ids.
+**
+** The SIZE*SIZE pixel grid is split into TILE_SIZE*TILE_SIZE tiles that are
+** only allocated the first time something is stored in them. Each tile keeps
+** one occupancy bit per pixel plus a packed array of the ids of occupied
+** pixels, so an empty pixel costs 1 bit rather than an 8 byte pointer.
+**
+** A second bit per pixel (room) mirrors membership of the spatial index
+** (path != NO_NODE and count < thickness), so searches can step over full
+** cells without decoding their ids.
+*/
+
+#define TILE_BITS 6
+#define TILE_SIZE (1 << TILE_BITS)  // must be 64: one uint64_t of bits per column
+#define TILE_MASK (TILE_SIZE - 1)
+
+   // reserved CellIds (see also cells.h)
+#define GRID_EMPTY    0  // nothing at this pixel
+#define GRID_BLOCKED  1  // fovea, raphe or ONH (only used during setup)
+
+typedef struct tile {
+   uint64_t occupied[TILE_SIZE]; // bit ly of occupied[lx] is set if (lx,ly) holds an id
+   uint64_t room[TILE_SIZE];     // bit ly of room[lx] is set if the cell there is in the spatial index
+   uint16_t rank[TILE_SIZE];     // number of set bits in occupied[0..lx-1]
+   int len;                      // ids[0..len-1] are valid
+   int cap;
+   CellId *ids;                  // ids of occupied pixels in (lx,ly) order
+} Tile;
+
+   // pixels whose id, occupied or room bit changed since the log was cleared
+typedef struct gridLog {
+   int len;
+   int cap;
+   Point *p;
+} GridLog;
+
+struct grid {
+   int size;            // pixels per side
+   int tilesPerSide;
+   Tile **tiles;        // tiles[tx * tilesPerSide + ty], NULL until first written
+   GridLog *log;        // if not NULL, every change is appended here
+};
+
+Grid *grid_new(int size);
+void grid_free(Grid *g);
+void grid_clear(Grid *g);
+void grid_set_id(Grid *g, int x, int y, CellId id);
+void grid_clear_blocked(Grid *g);
+void grid_set_room(Grid *g, int x, int y, int room);
+int grid_write(const Grid *g, FILE *f);
+Grid *grid_read(FILE *f);
+
+   // is bit for (x,y) set in a tile's occupied[] or room[]
+#define TILE_BIT(_words, _x, _y) (((_words)[(_x) & TILE_MASK] >> ((_y) & TILE_MASK)) & 1)
+
+/*
+** Tile holding (x,y), or NULL if it has not been allocated.
+*/
+static inline const Tile *
+grid_tile(const Grid *g, int x, int y) {
+   return g->tiles[(x >> TILE_BITS) * g->tilesPerSide + (y >> TILE_BITS)];
+}//grid_tile()
+
+/*
+** Return id stored at (x,y), or GRID_EMPTY.
+*/
+static inline CellId
+grid_get_id(const Grid *g, int x, int y) {
+   const Tile *t = grid_tile(g, x, y);
+   if (t == NULL)
+      return GRID_EMPTY;
+
+   uint64_t word = t->occupied[x & TILE_MASK];
+   uint64_t bit  = (uint64_t)1 << (y & TILE_MASK);
+   if (!(word & bit))
+      return GRID_EMPTY;
+
+   return t->ids[t->rank[x & TILE_MASK] + __builtin_popcountll(word & (bit - 1))];
+}//grid_get_id()
+
+/*
+** The one accessor used by the search and growth code:
+** the Cell at (x,y) or NULL if there is none.
+*/
+static inline Cell *
+grid_get(const Grid *g, int x, int y) {
+   CellId id = grid_get_id(g, x, y);
+   return id < FIRST_CELL_ID ? NULL : cell_from_id(id);
+}//grid_get()
+
+#endif
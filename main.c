@@ -12,71 +12,95 @@
 **
 */
 
-#include <gsl/gsl_rng.h>
-#include <gdk/gdk.h>
 #include <glib.h>
 #include <math.h>
+#include <string.h>
 #include <values.h>
+#include <limits.h>
 #include <assert.h>
+#include <time.h>
 #include "setup.h"
 #include "queue.h"
 #include "density.h"
 #include "types.h"
+#include "grid.h"
+#include "cells.h"
+#include "spatial.h"
+#include "scan.h"
+#include "sector.h"
+#include "pathfile.h"
+#include "checkpoint.h"
+#include "pool.h"
+#include "stats.h"
+#include "progress.h"
+#include "rnfl.h"
+#include "main.h"
 
 int debug = 0; 
 
 #define PRINT_ENDPOINTS
 #define PRINT_PATHS 1000
-//#define PRINT_OCT_PROFILE
 
    // macros for handling byte for count and thickness
 //#define IS_ROOM(_c) (((_c)->thickness != UCHAR_MAX) && ( (_c)->count < (_c)->thickness))
 //#define INC_COUNT(_c) do { (_c)->count += (((_c)->count) < UCHAR_MAX) ? 1 : 0; } while (0);
-#define IS_ROOM(_c) ((_c)->count < (_c)->thickness)
-#define INC_COUNT(_c) do { (_c)->count += 1; } while (0);
+   // one more path through the cell _id, whose CellRoom is _r (IS_ROOM() is in cells.h)
+#define INC_COUNT(_s, _id, _r) do { (_r)->count += 1; if ((_r)->count == (_r)->thickness && (_r)->thickness != THICK_UNLIMITED) spatial_remove((_s)->spatial, CELL(_id)); } while (0);
 
-PointD *scanPoints; // list of deltaX, deltaY, theta to use for searching grid
-int scanPointLen;   // scanPoints[0..scanPointLen-1] are valid
+ScanTable *scanTable; // scanPoints grouped by sector for findNewPath
 
-extern Cell *cellBlock; // from setup.c
-extern int numCells;    // from setup.c
+
+#define SPEC_BATCH    (16 * pool_workers())  // cells speculated on together by process_speculative()
+#define SPEC_SEGMENTS 4096                   // most targets per cell that speculate() follows
+
+   // set of non-zero keys (open addressing, 0 is an empty slot)
+typedef struct idSet {
+   int len;
+   int mask;            // table has mask+1 entries
+   uint32_t *table;
+} IdSet;
+
+#define IDSET_HASH(_k) ((int)(((_k) * 2654435761u) >> 8))
+
+   // cells that a findNewPath search must skip (instead of those marked on the path):
+   // target, the cells, and fake cells that are not made yet (by position)
+typedef struct exclude {
+   CellId target;
+   IdSet cells;
+   IdSet fakes;         // key x * SIZE + y + 1
+} Exclude;
+
+   // one target of makeOnePath, as speculate() predicted it
+typedef struct segment {
+   Point target;        // target's position
+   NodeId full;         // first Node on target's path with no room, or NO_NODE
+   int k;               // -2 if no search, else findNewPath stopped at
+                        // scanTable->pts[k] (-1 for none), decided by...
+   long searchD2;       // ...the grid within this squared distance of full's cell
+} Segment;
+
+   // what the read only part of growing one cell found, before any
+   // earlier cell in the same batch was grown (see process_speculative)
+typedef struct prediction {
+   Cell *closest;       // findClosestCompleted(), which was decided by...
+   long closestD2;      // ...the grid within this squared distance of the cell
+   int nSeg;
+   int capSeg;
+   Segment *seg;
+   int logLen;          // grid->log->len when the cell started growing
+} Prediction;
 
 /*
-** Initialise scanPoints array
-**    p.x = delta x from 0
-**    p.y = delta y from 0
-**    dist = angle of (x,y) from centre (radians)
-** Elements are sorted by distance from (0,0)
-**
-** Sets scanPointLen.
+** Return 1 if key is in s, 0 otherwise.
 */
-void
-init_scanPoints() {
-   scanPoints = (PointD *) malloc(sizeof(PointD)*(2*NEW_PATH_RADIUS_LIMIT+1)*(2*NEW_PATH_RADIUS_LIMIT+1));
-   assert(scanPoints != NULL);
-
-      // use dist temporarily for sorting
-   int index = 0;
-   for(int i = -NEW_PATH_RADIUS_LIMIT ; i <= +NEW_PATH_RADIUS_LIMIT ; i++)
-      for(int j = -NEW_PATH_RADIUS_LIMIT ; j <= +NEW_PATH_RADIUS_LIMIT ; j++) {
-         if (i == 0 && j == 0) continue;  // exclude (0,0)
-         Point p = {i,j};
-         Point po = {0,0};
-         float dist = DIST(p,po);
-         if (dist > NEW_PATH_RADIUS_LIMIT) continue;    // exclude corner points
-         scanPoints[index].p.x = i;
-         scanPoints[index].p.y = j;
-         scanPoints[index].dist = dist;
-         index++;
-      }
-
-   scanPointLen = index;
-   qsort(scanPoints, scanPointLen, sizeof(PointD), cmp_PointD);
+static inline int
+idset_has(const IdSet *s, uint32_t key) {
+   for(int h = IDSET_HASH(key) & s->mask ; s->table[h] != 0 ; h = (h + 1) & s->mask)
+      if (s->table[h] == key)
+         return 1;
+   return 0;
+}//idset_has()
 
-      // now replace dist with theta
-   for(int i = 0 ; i < scanPointLen ; i++)
-      scanPoints[i].dist = atan2(scanPoints[i].p.y, scanPoints[i].p.x);
-}//init_scanPoints()
 
 /*
 ** Return 1 if (x,y) is inside FOVEA_RADIUS, 0 otherwise
@@ -104,226 +128,403 @@ cross_raphe(Point a, Point b) {
 ** Just print cell position and last point of path,
 ** or fll path if full=TRUE
 */
-void print_path(Cell *c, char full) {
+void print_path(FILE *f, Cell *c, char full) {
    if (full) {
-      Node *p = c->path; 
-      while (p != NULL) {
-         printf("%6d %6d\n",p->c->p.x, p->c->p.y);
-         p = p->next;
+      NodeId p = c->path; 
+      while (p != NO_NODE) {
+         fprintf(f, "%6d %6d\n",CELL(NODE(p)->c)->p.x, CELL(NODE(p)->c)->p.y);
+         p = NODE(p)->next;
       }
-      printf("-1 -1\n");
+      fprintf(f, "-1 -1\n");
    } else {
-      if (c->path != NULL) {
+      if (c->path != NO_NODE) {
             // just print first and last
-         Node *p = c->path;
-         printf("%6d %6d ",p->c->p.x, p->c->p.y);
-         while(p->next != NULL)
-            p = p->next;
+         Node *p = NODE(c->path);
+         fprintf(f, "%6d %6d ",CELL(p->c)->p.x, CELL(p->c)->p.y);
+         while(p->next != NO_NODE)
+            p = NODE(p->next);
 
-         printf("%6d %6d\n",p->c->p.x, p->c->p.y);
+         fprintf(f, "%6d %6d\n",CELL(p->c)->p.x, CELL(p->c)->p.y);
       }
    }
-   fflush(stdout);
+   fflush(f);
 }//print_path()
 
+/*
+** Return 1 if a findNewPath search would stop at (x,y): either an empty
+** pixel outside the fovea (a fake cell will be made there), or a cell
+** not on the current path that has a path and room.
+** Cells with a path and room are exactly those with their grid room bit set.
+** The current path is the cells marked since sec->pathMark (see sector.h),
+** or those in ex if not NULL.
+** Empty pixels outside sec's wedge (if it has one) are not used.
+*/
+static inline int
+can_join(Sector *sec, const Exclude *ex, int x, int y) {
+   if ((x < 0) || (x >= SIZE)) return 0;        // off grid
+   if ((y < 0) || (y >= SIZE)) return 0;
+   Grid *grid = sec->grid;
+   const Tile *t = grid_tile(grid, x, y);
+   if (t == NULL || !TILE_BIT(t->occupied, x, y)) {
+      if (ex != NULL && ex->fakes.len > 0 && idset_has(&ex->fakes, x * SIZE + y + 1))
+         return 0;
+      if (sec->wedge && sector_of(x, y) != sec->id)
+         return 0;
+      return !in_fovea(x,y);
+   }
+   if (!TILE_BIT(t->room, x, y))
+      return 0;
+   CellId id = grid_get_id(grid, x, y);
+   if (ex == NULL)
+      return ROOM(id)->mark < sec->pathMark;
+
+   return id != ex->target && !idset_has(&ex->cells, id);
+}//can_join()
+
+/*
+** First point of group [from, to) of scanTable that can_join from p, with
+** rank less than *bestRank. The group is in rank order, so stop as soon
+** as rank reaches *bestRank. Angles are only tested if testAngle.
+** On success updates *bestRank and returns index into scanTable->pts, else -1.
+*/
+static inline int
+scan_group(Sector *sec, const Exclude *ex, Point p, int from, int to, int testAngle, double lo, double hi, int *bestRank) {
+   PointD *pts = scanTable->pts;
+   int *rank = scanTable->rank;
+   if (testAngle) {
+      for(int k = from ; k < to && rank[k] < *bestRank ; k++) {
+         if (pts[k].dist < lo) continue;    // outside theta range
+         if (pts[k].dist > hi) continue;
+         if (can_join(sec, ex, p.x + pts[k].p.x, p.y + pts[k].p.y)) {
+            *bestRank = rank[k];
+            return k;
+         }
+      }
+   } else {
+      for(int k = from ; k < to && rank[k] < *bestRank ; k++)
+         if (can_join(sec, ex, p.x + pts[k].p.x, p.y + pts[k].p.y)) {
+            *bestRank = rank[k];
+            return k;
+         }
+   }
+   return -1;
+}//scan_group()
+
+/*
+** Return the index into scanTable->pts of the first scanPoint (in distance order)
+** from p that has angle in [lo, hi], is in one of the halves in halfMask, and
+** can_join() (passing on ex), or -1 if there is none.
+**
+** Sectors wholly outside [lo, hi] are never visited, and only the (at most two)
+** sectors straddling lo or hi test angles per point. Each band is searched
+** group by group and the lowest rank wins, which gives the same answer as a
+** single walk along scanPoints.
+*/
+static int
+scan_first(Sector *sec, const Exclude *ex, Point p, double lo, double hi, int halfMask) {
+   int group[SCAN_SECTORS * SCAN_HALVES];   // active (sector, half) pairs...
+   int test[SCAN_SECTORS * SCAN_HALVES];    // ...and whether they need an angle test
+   int nGroups = 0;
+   for(int s = 0 ; s < SCAN_SECTORS ; s++)
+      for(int h = 0 ; h < SCAN_HALVES ; h++) {
+         if (!(halfMask & (1 << h))) continue;
+         float min = scanTable->minAngle[s][h];
+         float max = scanTable->maxAngle[s][h];
+         if (max < lo || min > hi) continue;    // empty, or entirely outside theta range
+         group[nGroups]  = s * SCAN_HALVES + h;
+         test[nGroups++] = (min < lo || max > hi);
+      }
+
+   for(int b = 0 ; b < scanTable->nBands ; b++) {
+      int *start = scanTable->start + SCAN_GROUP(b, 0, 0);
+      int bestRank = INT_MAX;
+      int best = -1;
+      for(int g = 0 ; g < nGroups ; g++) {
+         int k = scan_group(sec, ex, p, start[group[g]], start[group[g] + 1], test[g], lo, hi, &bestRank);
+         if (k >= 0)
+            best = k;
+      }
+      if (best >= 0)
+         return best;
+   }
+   return -1;
+}//scan_first()
+
+/*
+** Search outwards from target (see scan_first) for the closest point in the
+** direction of target from current (+-THETA_LIMIT) that can_join(). Left of
+** the fovea only offsets on target's side of the raphe are considered.
+** Returns index into scanTable->pts, or -1. Only reads the grid and cells.
+*/
+static int
+search_new_path(Point current, Point target, Sector *sec, const Exclude *ex) {
+   double theta = atan2(target.y - current.y, target.x - current.x);
+
+   int halfMask = SCAN_ALL_HALVES;
+   if ((target.x < SIZE/2) && (target.y < SIZE/2))    // away from raphe, x < fov only
+      halfMask = (1 << SCAN_NEG) | (1 << SCAN_ZERO);
+   if ((target.x < SIZE/2) && (target.y > SIZE/2))
+      halfMask = (1 << SCAN_ZERO) | (1 << SCAN_POS);
+
+   return scan_first(sec, ex, target, theta - THETA_LIMIT, theta + THETA_LIMIT, halfMask);
+}//search_new_path()
+
+/*
+** Return 1 if none of the first len pixels in log is within squared
+** distance d2 of p, 0 otherwise.
+*/
+static int
+unchanged_near(const GridLog *log, int len, Point p, long d2) {
+   for(int i = 0 ; i < len ; i++) {
+      long dx = log->p[i].x - p.x;
+      long dy = log->p[i].y - p.y;
+      if (dx * dx + dy * dy <= d2)
+         return 0;
+   }
+   return 1;
+}//unchanged_near()
+
 /*
 ** Find closest cell in the direction of target from current (+-THETA_LIMIT)
 ** that is not target, and that has room to be part of a path.
 **
-** Use a spiral search (well, they're squares of increasing dist) outwards from
-** current ignoring cells with flag==1, points outside theta range, and 
-** count >= thickness.
+** Search (see search_new_path) ignoring cells on the current path, points outside
+** theta range, and count >= thickness, unless seg (if not NULL) already holds
+** the answer and no pixel it depended on is in the first logLen of sec->grid->log.
+** If the first hit is an empty pixel, a fake cell is made there.
+** Returns the id of the cell found, or NO_CELL.
 */
-Cell *
-findNewPath(Cell *current, Cell *target, Grid **grid) {
+CellId
+findNewPath(Cell *current, CellId targetId, Sector *sec, const Segment *seg, int logLen) {
+   Cell *target = CELL(targetId);
 if (debug)printf("# current = %5d %5d ",current->p.x, current->p.y);
 if (debug)printf(" wants %5d %5d ",target->p.x, target->p.y);
 
-   double theta = atan2(target->p.y - current->p.y, target->p.x - current->p.x);
-
-   target->flag = 1; // rule out current
-   Cell *c, *minC = NULL;
-   for(PointD *s = scanPoints ; (s < scanPoints + scanPointLen) && (minC == NULL) ; s++) {
-      if (s->dist < theta - THETA_LIMIT) continue;    // outside theta range
-      if (s->dist > theta + THETA_LIMIT) continue;
-      if ((target->p.x < SIZE/2) && (target->p.y < SIZE/2) && (s->p.y > 0)) continue; // away from raphe, x < fov only
-      if ((target->p.x < SIZE/2) && (target->p.y > SIZE/2) && (s->p.y < 0)) continue; // away from raphe, x < fov only
-      int x = target->p.x + s->p.x;
-      int y = target->p.y + s->p.y;
-      if ((x < 0) || (x >= SIZE)) continue;        // off grid
-      if ((y < 0) || (y >= SIZE)) continue;
-      //if ((target->p.y < SIZE/2) && (y > SIZE/2)) continue; // no cross raphe
-      //if ((target->p.y > SIZE/2) && (y < SIZE/2)) continue; // no cross raphe
-
-      if ((c = grid[x][y].soma) == NULL)  {   // blanko - make a fake cell 
-         if (in_fovea(x,y)) continue;         // but not if in fovea
-
-         c = (Cell *)malloc(sizeof(Cell));
-         c->p.x       = x;
-         c->p.y       = y;
-         //Point po = {ONH_X, ONH_Y};
-         //double theta = atan2((double) y - (double)ONH_Y, (double) x - (double)ONH_X);
-         //c->distToOnh = DIST(c->p,po) - ONH_EDGE(theta);
-         c->count     = 0;
-         int distFromFovea = MACULAR_DIST_SQ(c->p);
-         c->thickness = MAX_AXON_COUNT(sqrt(distFromFovea));
-         c->flag      = 0;
-         c->alternate = NULL;
+   sec->stats.newPathCalls++;
+   int k;
+   if (seg != NULL && seg->k >= -1 && unchanged_near(sec->grid->log, logLen, target->p, seg->searchD2)) {
+      k = seg->k;
+      sec->stats.newPathSpeculated++;
+   } else {
+      ROOM(targetId)->mark = sec->mark; // rule out current
+      k = search_new_path(current->p, target->p, sec, NULL);
+      ROOM(targetId)->mark = 0;         // reset current mark
+   }
+
+   if (k < 0)
+      return NO_CELL;
+
+   int x = target->p.x + scanTable->pts[k].p.x;
+   int y = target->p.y + scanTable->pts[k].p.y;
+   CellId id = grid_get_id(sec->grid, x, y);
+   if (id == GRID_EMPTY) {   // blanko - make a fake cell 
+      id = new_fake_cell(sec->id);
+      sec->stats.fakeCells++;
+      Cell *c = CELL(id);
+      CellRoom *r = ROOM(id);
+      c->p.x       = x;
+      c->p.y       = y;
+      //Point po = {ONH_X, ONH_Y};
+      //double theta = atan2((double) y - (double)ONH_Y, (double) x - (double)ONH_X);
+      //c->distToOnh = DIST(c->p,po) - ONH_EDGE(theta);
+      r->count     = 0;
+      int distFromFovea = MACULAR_DIST_SQ(c->p);
+      r->thickness = MAX_AXON_COUNT(sqrt(distFromFovea));
+      r->mark      = 0;
+      c->alternate = NO_CELL;
+      c->slot      = -1;
 if (debug) {
-if (target->path->next == NULL)
+if (NODE(target->path)->next == NO_NODE)
 printf("Fake cell (%5d,%5d) -> (%5d,%5d)\n",x,y,-1, -1);
 else
-printf("Fake cell (%5d,%5d) -> (%5d,%5d) th=%u\n",x,y,target->path->next->c->p.x, target->path->next->c->p.y,c->thickness);
+printf("Fake cell (%5d,%5d) -> (%5d,%5d) th=%u\n",x,y,CELL(NODE(NODE(target->path)->next)->c)->p.x, CELL(NODE(NODE(target->path)->next)->c)->p.y,r->thickness);
 }
 
-         Node *p = malloc(sizeof(Node));  // self then target.path->next
-         p->c = c;
-         p->next = target->path->next;
-         c->path = p;
+      c->path = new_node(sec->id, id, NODE(target->path)->next);  // self then target.path->next
 
-         grid[x][y].soma = c;
-      } else {
-         if (c->flag)         continue;    // on current path
-         if (c->path == NULL) continue;    // has no path
-         if (!IS_ROOM(c))     continue;    // no room
-      }
-      minC = c;
+      grid_set_id(sec->grid, x, y, id);
+      if (IS_ROOM(r))
+         spatial_insert(sec->spatial, c, id);
    }
-//if (minC == NULL)
-//printf(" gets NULL  NULL\n");
-//else
-//printf(" gets %5d %5d\n",minC->p.x, minC->p.y);
-
-   target->flag = 0; // reset current flag
+//if (debug) printf(" gets %5d %5d\n",CELL(id)->p.x, CELL(id)->p.y);
 
-   return minC;
+   return id;
 }//findNewPath()
 
+/*
+** Paths form a forest of Nodes: Node.next is the parent, and the roots are
+** the single Nodes of the start cells next to the ONH. A new axon follows
+** an existing path until it meets a cell with no room, which needs the
+** "first full node" on the path and +1 on the count of every cell before it.
+**
+** A cell's count is shared by every Node that refers to it, and copied path
+** prefixes mean one cell can sit on many branches of the forest, so there is
+** no per-node aggregate to keep (as HLD or link-cut trees would need).
+** Instead walk_path() does the query and the increments in the same pass.
+*/
+
+/*
+** Walk the path from n towards the ONH, doing INC_COUNT on each cell with
+** room (and marking it with the segment's mark, sec->mark) until either a cell has no room
+** (return its Node) or the last Node is reached (not counted, return NO_NODE).
+** *walked is incremented for each cell counted.
+*/
+static NodeId
+walk_path(Sector *sec, NodeId n, long *walked) {
+   for(;;) {
+      Node *node = NODE(n);
+      CellRoom *r = ROOM(node->c);
+if (debug)printf("\t\tcheck (%5d, %5d) count=%d < th=%u\n", CELL(node->c)->p.x, CELL(node->c)->p.y, r->count, r->thickness);
+      if (!IS_ROOM(r))
+         return n;
+      if (node->next == NO_NODE)
+         return NO_NODE;
+      INC_COUNT(sec, node->c, r);
+      r->mark = sec->mark;
+      (*walked)++;
+      n = node->next;
+   }
+}//walk_path()
+
+/*
+** As walk_path(), but no cell can stop the walk.
+*/
+static NodeId
+walk_rest(Sector *sec, NodeId n, long *walked) {
+   for( ; NODE(n)->next != NO_NODE ; n = NODE(n)->next) {
+      CellRoom *r = ROOM(NODE(n)->c);
+      INC_COUNT(sec, NODE(n)->c, r);
+      r->mark = sec->mark;
+      (*walked)++;
+   }
+   return NO_NODE;
+}//walk_rest()
+
+/*
+** walk_path() stopped at full, a cell that it had already counted once
+** earlier on the same path. Had the path been checked before counting
+** (as it used to be), would every cell from full onwards have had room?
+** Slow, but only needed when a path visits a cell twice.
+*/
+static int
+all_room_before(NodeId start, NodeId full) {
+   for(NodeId m = full ; m != NO_NODE ; m = NODE(m)->next) {
+      CellRoom *r = ROOM(NODE(m)->c);
+      unsigned int counted = 0;
+      for(NodeId k = start ; k != full ; k = NODE(k)->next)
+         if (NODE(k)->c == NODE(m)->c)
+            counted++;
+      if (r->thickness != THICK_UNLIMITED && r->count - counted >= r->thickness)
+         return 0;
+   }
+   return 1;
+}//all_room_before()
+
 /*
 ** For cell cc, whose nearest (completed) neighbour is c, begin a path at c->path.
 ** Follow c's path as far as possible, and jump to a new c if needed.
+** pred (if not NULL) is what speculate() expects to happen: it is followed
+** while each target and full node agree with it, then dropped.
 ** Return 1 if success, 0 if fail to find path.
 */
 int 
-makeOnePath(int icc, Cell *target, Grid **grid) {
+makeOnePath(int icc, Cell *target, Sector *sec, const Prediction *pred) {
    Cell *current = cellBlock + icc;
 /*
-if (grid[9997][10445].soma != NULL) {
-    Node *n = grid[9997][10445].soma->path;
-    if (grid[9997][10445].soma->alternate != NULL)
-        n = grid[9997][10445].soma->alternate->path;
-    if (n != NULL) {
-        printf("(%5d,%5d)", n->c->p.x, n->c->p.y);
-        if (n->next != NULL) printf("->(%5d,%5d)", n->next->c->p.x, n->next->c->p.y);
-        while (n->next != NULL)
-            n = n->next;
-        printf("...(%5d,%5d)\n", n->c->p.x, n->c->p.y);
+if (grid_get(sec->grid, 9997, 10445) != NULL) {
+    NodeId n = grid_get(sec->grid, 9997, 10445)->path;
+    if (grid_get(sec->grid, 9997, 10445)->alternate != NO_CELL)
+        n = CELL(grid_get(sec->grid, 9997, 10445)->alternate)->path;
+    if (n != NO_NODE) {
+        printf("(%5d,%5d)", CELL(NODE(n)->c)->p.x, CELL(NODE(n)->c)->p.y);
+        if (NODE(n)->next != NO_NODE) printf("->(%5d,%5d)", CELL(NODE(NODE(n)->next)->c)->p.x, CELL(NODE(NODE(n)->next)->c)->p.y);
+        while (NODE(n)->next != NO_NODE)
+            n = NODE(n)->next;
+        printf("...(%5d,%5d)\n", CELL(NODE(n)->c)->p.x, CELL(NODE(n)->c)->p.y);
     } else
         printf("( 9997,10445)...NULL?)\n");
 }
 */
 
 if (debug) printf("Current = (%5d,%5d)\n", current->p.x, current->p.y);
+   sector_new_path(sec);
       // First, put in a start of path node at self
       // Note no space checking (assuming axon can start here)
-   current->path = (Node *)malloc(sizeof(Node));
-   current->path->c         = current;
-   current->path->next      = NULL;
-   INC_COUNT(current);
+   current->path = new_node(sec->id, FIRST_CELL_ID + icc, NO_NODE);
+   INC_COUNT(sec, FIRST_CELL_ID + icc, roomBlock + icc);
 
-   Node *tail = current->path; // last entry in current path (new)
-   current->flag = 1;
+   Node *tail = NODE(current->path); // last entry in current path (new)
+   roomBlock[icc].mark = sec->pathMark;
    int result = 0;
+   int s = 0;                        // segment of pred that should match target
 
    while (target != NULL) {
 if (debug)printf("\ttarget = (%5d,%5d)\n", target->p.x, target->p.y);
-      result = 0; // assume fail
-             // check if we can just follow same path (to save memory)
-      Node *n = target->path;
-if (debug)printf("\t\tcheck (%5d, %5d) count=%d < th=%u\n", n->c->p.x, n->c->p.y,n->c->count, n->c->thickness);
-      while (n != NULL && IS_ROOM(n->c))
-{
-         n = n->next;
-if (debug)if (n!=NULL) printf("\t\tcheck (%5d, %5d) count=%d < th=%u\n", n->c->p.x, n->c->p.y,n->c->count, n->c->thickness);
-}
-      if (n == NULL) { // hooray! just incrememnt count in each cell on path 
+      if (pred != NULL && (s >= pred->nSeg || pred->seg[s].target.x != target->p.x || pred->seg[s].target.y != target->p.y))
+         pred = NULL;
+
+             // follow target's path in one pass, counting ourselves in as we go
+      sector_new_segment(sec);
+      long walked = 0;
+      NodeId n = walk_path(sec, target->path, &walked);
+      if (n != NO_NODE && ROOM(NODE(n)->c)->mark == sec->mark && all_room_before(target->path, n))
+         n = walk_rest(sec, n, &walked);
+      if (pred != NULL && pred->seg[s].full != n)
+         pred = NULL;
+
+      if (n == NO_NODE) { // hooray! counts are done, just share the rest of the path
 if (debug)printf("\tNo Copy required\n");
          tail->next = target->path;
-         n = target->path;
-         while ((n != NULL) && (n->next != NULL)) {
-            INC_COUNT(n->c);
-            n = n->next;
-         }
+         sec->stats.nodesShared += walked + 1;   // and the last, not counted
          target = NULL;
          result = 1; // yay, succeed
       } else {
-            // Path has to branch, so 
+            // Path has to branch at n, so 
             // we need to take a copy of path up to the point where there's
             // no room, make a new node there and follow on
-            // Mark all path nodes with flag = 1 to assist findNewPath
-         Node *follow = target->path;
-         while (IS_ROOM(follow->c)) {
-            Node *n = (Node *)malloc(sizeof(Node)); assert(n != NULL);
-            n->c    = follow->c;
-            n->next = NULL;
-            tail->next = n;
-            tail = n;
-            INC_COUNT(n->c);
-            n->c->flag  = 1;
-            follow = follow->next;
+            // (each is marked on the path already, by walk_path)
+         NodeId follow = target->path;
+         for( ; follow != n ; follow = NODE(follow)->next) {
+            NodeId copy = new_node(sec->id, NODE(follow)->c, NO_NODE);
+            tail->next = copy;
+            tail = NODE(copy);
+            sec->stats.nodesCopied++;
          }
 
-           // Note alternate could end up being NULL
-         if ((follow->c->alternate == NULL) || !IS_ROOM(follow->c->alternate))
-            follow->c->alternate = findNewPath(tail->c, follow->c, grid);
+           // Note alternate could end up being NO_CELL
+         Cell *fc = CELL(NODE(follow)->c);
+         if ((fc->alternate == NO_CELL) || !IS_ROOM(ROOM(fc->alternate)))
+            fc->alternate = findNewPath(CELL(tail->c), NODE(follow)->c, sec, pred == NULL ? NULL : pred->seg + s, pred == NULL ? 0 : pred->logLen);
+         else
+            sec->stats.alternateHits++;
 
-         target = follow->c->alternate;
+         target = fc->alternate == NO_CELL ? NULL : CELL(fc->alternate);
+         result = 0; // fail unless a later target works out
       }
-   }
-
-      // reset all the flags along path
-   Node *n = current->path;
-   while (n != NULL) {
-      n->c->flag = 0;
-      n = n->next;
+      s++;
    }
    return result;
 }//makeOnePath()
 
 /*
-** This version uses precomputed scanPoints array, but it might not be 
-** big enough when DENSE_SCALE is small
+** Nearest cell within NEW_PATH_RADIUS_LIMIT that has a path and room,
+** from the spatial index (same answer as a walk along scanPoints).
 */
 Cell *
-findClosestCompleted_restrictedArea(int i, Grid **grid) {
-   Cell *target = cellBlock + i;
-   Cell *minC = NULL;
-   for(PointD *s = scanPoints ; (s < scanPoints + scanPointLen) && (minC == NULL) ; s++) {
-      int x = target->p.x + s->p.x;
-      int y = target->p.y + s->p.y;
-      if ((x < 0) || (x >= SIZE)) continue;        // off grid
-      if ((y < 0) || (y >= SIZE)) continue;
-      Point p = {x,y};
-      if (cross_raphe(target->p, p)) continue;    
-
-      minC = grid[x][y].soma; // note could be NULL
-
-      if (minC != NULL && minC->path == NULL)                  // no path yet
-         minC = NULL;
-      if (minC != NULL && (minC->count >= minC->thickness))    // no room
-         minC = NULL;
-   }
-   return minC;
+findClosestCompleted_restrictedArea(int i, Sector *sec) {
+   sec->stats.closestCalls++;
+   return spatial_nearest(sec->spatial, cellBlock[i].p, &sec->stats.closestExamined);
 }//findClosestCompleted_restrictedArea()
 
 /*
-** Find the closest cell to cellBlock[i] in cellBlock[0..i-1]
+** Find the closest cell to cellBlock[i] among those grown before it
 ** towards the ONH
-** ASSUMES cellBlock is sorted in increasing distToOnh
+** (the search below ASSUMES cellBlock is sorted in increasing distToOnh,
+** as it was before cellOrder)
 */
 Cell *
-findClosestCompleted(int i, Grid **grid) {
-   Cell *res = findClosestCompleted_restrictedArea(i, grid);
+findClosestCompleted(int i, Sector *sec) {
+   Cell *res = findClosestCompleted_restrictedArea(i, sec);
 //   if (res != NULL)
       return res;
 
@@ -331,8 +532,8 @@ findClosestCompleted(int i, Grid **grid) {
    float minD = DIST(cellBlock[i-1].p, cellBlock[i].p);
    int   minJ = i-1;
    for(int j = i-2 ; j >= 0 ; j--) {
-      if (cellBlock[j].path  == NULL)                   continue;  // no path yet
-      if (cellBlock[j].count >= cellBlock[j].thickness) continue;  // no room
+      if (cellBlock[j].path  == NO_NODE)                continue;  // no path yet
+      if (!IS_ROOM(roomBlock + j))                      continue;  // no room
       if (cross_raphe(cellBlock[i].p, cellBlock[j].p))  continue;  // crosses raphe
       float dist = DIST(cellBlock[j].p, cellBlock[i].p);
       if ((dist < minD)) {
@@ -345,83 +546,682 @@ findClosestCompleted(int i, Grid **grid) {
 }//findClosestCompleted()
 
 /*
-** Print thickness values at each degree on a circle of radius radius mm
+** Empty s, allocating its table the first time.
+*/
+static void
+idset_clear(IdSet *s) {
+   if (s->table == NULL) {
+      s->mask  = 1023;
+      s->table = (uint32_t *)calloc(s->mask + 1, sizeof(uint32_t));
+      assert(s->table != NULL);
+   } else if (s->len > 0) {
+      memset(s->table, 0, sizeof(uint32_t) * (s->mask + 1));
+   }
+   s->len = 0;
+}//idset_clear()
+
+/*
+** Add key (!= 0) to s, doubling the table when it gets half full.
+*/
+static void
+idset_add(IdSet *s, uint32_t key) {
+   if (2 * (s->len + 1) > s->mask + 1) {
+      int oldSize = s->mask + 1;
+      uint32_t *old = s->table;
+      s->mask  = 2 * oldSize - 1;
+      s->table = (uint32_t *)calloc(s->mask + 1, sizeof(uint32_t));
+      assert(s->table != NULL);
+      s->len = 0;
+      for(int i = 0 ; i < oldSize ; i++)
+         if (old[i] != 0)
+            idset_add(s, old[i]);
+      free(old);
+   }
 
-needs work as count now in cells, so have to find closest, etc.. Horrible!
+   int h = IDSET_HASH(key) & s->mask;
+   for( ; s->table[h] != 0 ; h = (h + 1) & s->mask)
+      if (s->table[h] == key)
+         return;
+   s->table[h] = key;
+   s->len++;
+}//idset_add()
+
+/*
+** Do the read only part of makeOnePath for cellBlock[i] into pr: find the
+** closest completed cell, then follow targets as makeOnePath would, but
+** without counting, keeping the path so far in ex rather than marked, and
+** remembering fake cells by position rather than making them.
+** Gives up (leaving the rest to makeOnePath) after SPEC_SEGMENTS targets
+** or at a fake with no room. Being wrong only costs time: makeOnePath
+** checks every target and full node against the real ones.
+** Touches nothing but pr and ex, so many cells can be done at once.
+*/
+static void
+speculate(int i, Sector *sec, Exclude *ex, Prediction *pr) {
+   Cell *current = cellBlock + i;
+   pr->closest = NULL;
+   pr->nSeg    = 0;
+   if (current->p.x > 14 * PIXELS_PER_MM) return;
+
+   pr->closest = spatial_nearest(sec->spatial, current->p, NULL);   // findClosestCompleted(), uncounted
+   if (pr->closest == NULL) {
+      pr->closestD2 = (long)sec->spatial->radius * sec->spatial->radius;
+      return;
+   }
+   long dx = pr->closest->p.x - current->p.x;
+   long dy = pr->closest->p.y - current->p.y;
+   pr->closestD2 = dx * dx + dy * dy;
 
+   ex->target = NO_CELL;
+   idset_clear(&ex->cells);
+   idset_clear(&ex->fakes);
+   idset_add(&ex->cells, FIRST_CELL_ID + i);
+   Point tail = current->p;
+   Cell *target = pr->closest;         // NULL if target is a fake not made yet...
+   Point fake;                         // ...at fake
+   NodeId n = target->path;            // target's path (after fake, if a fake)
+
+   while (pr->nSeg < SPEC_SEGMENTS) {
+      if (pr->nSeg == pr->capSeg) {
+         pr->capSeg = pr->capSeg == 0 ? 64 : 2 * pr->capSeg;
+         pr->seg = (Segment *)realloc(pr->seg, sizeof(Segment) * pr->capSeg);
+         assert(pr->seg != NULL);
+      }
+      Segment *seg = pr->seg + pr->nSeg++;
+      seg->full = NO_NODE;
+      if (target == NULL) {
+         seg->target = fake;
+         int distFromFovea = MACULAR_DIST_SQ(fake);
+         unsigned int thickness = MAX_AXON_COUNT(sqrt(distFromFovea));
+         if (thickness == 0) {        // as findNewPath() would make it
+            pr->nSeg--;
+            return;
+         }
+         if (n == NO_NODE)
+            return;
+         idset_add(&ex->fakes, fake.x * SIZE + fake.y + 1);
+         tail = fake;
+      } else {
+         seg->target = target->p;
+      }
+
+      for(;;) {
+         Node *node = NODE(n);
+         if (!IS_ROOM(ROOM(node->c)))
+            break;
+         if (node->next == NO_NODE)
+            return;
+         idset_add(&ex->cells, node->c);
+         tail = CELL(node->c)->p;
+         n = node->next;
+      }
+      seg->full = n;
+
+      Cell *fc = CELL(NODE(n)->c);
+      seg->k = -2;
+      if ((fc->alternate != NO_CELL) && IS_ROOM(ROOM(fc->alternate))) {
+         target = CELL(fc->alternate);
+         n = target->path;
+         continue;
+      }
+      ex->target = NODE(n)->c;
+      seg->k = search_new_path(tail, fc->p, sec, ex);
+      ex->target = NO_CELL;
+      if (seg->k < 0) {
+         seg->searchD2 = (long)sec->spatial->radius * sec->spatial->radius;
+         return;
+      }
+      Point off = scanTable->pts[seg->k].p;
+      seg->searchD2 = (long)off.x * off.x + (long)off.y * off.y;
+
+      CellId id = grid_get_id(sec->grid, fc->p.x + off.x, fc->p.y + off.y);
+      if (id == GRID_EMPTY) {
+         target = NULL;
+         fake.x = fc->p.x + off.x;
+         fake.y = fc->p.y + off.y;
+         n = NODE(fc->path)->next;
+      } else {
+         target = CELL(id);
+         n = target->path;
+      }
+   }
+}//speculate()
+
+typedef struct specBatch {
+   Sector *sec;
+   int from;               // this batch starts at cellOrder[from]
+   Prediction *pred;       // pred[k - from] for cellOrder[k]
+   Exclude *ex;            // scratch for each worker of the pool
+} SpecBatch;
+
+/*
+** Pool task: speculate on cell from+k of the batch.
+*/
+static void
+speculate_task(void *arg, int k, int worker) {
+   SpecBatch *sb = (SpecBatch *)arg;
+   speculate(cellOrder[sb->from + k], sb->sec, sb->ex + worker, sb->pred + k);
+}//speculate_task()
+
+/*
+** Grow the path for cellBlock[cellOrder[k]], using pred (if not NULL) where
+** sec->grid->log shows nothing it depended on has changed.
+** If sec->failed is not NULL, failures (k) are put there rather than reported
+** (or counted as done for progress.h, as they will be tried again).
+*/
 void
-print_oct(Grid **grid, float radius) {
-   for(float theta = 0 ; theta < 360 ; theta++) {
-      int x = (int)round(radius * cos(theta)*PIXELS_PER_MM + ONH_X);
-      int y = (int)round(radius * sin(theta)*PIXELS_PER_MM + ONH_X);
-      printf("%3.0f %d\n",theta, grid[x][y]);
+grow(int k, Sector *sec, Prediction *pred) {
+   Grid *grid = sec->grid;
+   int i = cellOrder[k];
+   if (cellBlock[i].p.x > 14 * PIXELS_PER_MM) {
+      progress_cell(i, 0);
+      return;
+   }
+   //if (cellBlock[i].p.x > ONH_X) return;
+   //if (cellBlock[i].p.x < 5000) return;
+   //if (cellBlock[i].p.y < 5000) return;
+   //if (cellBlock[i].p.y > 15000) return;
+   //Cell *closest = cellBlock + findClosestCompleted(i);
+   Cell *closest;
+   if (pred != NULL && unchanged_near(grid->log, grid->log->len, cellBlock[i].p, pred->closestD2)) {
+      closest = pred->closest;
+      pred->logLen = grid->log->len;
+      sec->stats.closestCalls++;     // counted as if searched (see stats.h)
+      sec->stats.closestSpeculated++;
+   } else {
+      closest = findClosestCompleted(i, sec);
+      if (pred != NULL && closest == pred->closest)
+         pred->logLen = grid->log->len;
+      else
+         pred = NULL;
    }
-}//print_oct()
+   if (closest == NULL) {
+      cellBlock[i].status = CELL_NO_NEAR;
+      if (sec->failed == NULL)
+         progress_cell(i, 1);
+      if (sec->failed != NULL)
+         sec->failed[sec->nFailed++] = k;
+      else if (sec->out != NULL)
+         fprintf(sec->out, "# Kn %d %d\n",cellBlock[i].p.x,cellBlock[i].p.y);
+      return;
+   }
+      // the cell's pixel can only have been taken (by a fake) in sectors_merge()
+   int inGrid = grid_get_id(grid, cellBlock[i].p.x, cellBlock[i].p.y) == FIRST_CELL_ID + i;
+   if (makeOnePath(i, closest, sec, pred)) { 
+      cellBlock[i].status = CELL_GROWN;
+      progress_cell(i, 0);
+      if (IS_ROOM(roomBlock + i) && inGrid)
+         spatial_insert(sec->spatial, cellBlock + i, FIRST_CELL_ID + i);
+      #ifdef PRINT_ENDPOINTS
+      if (sec->out != NULL)
+         print_path(sec->out, cellBlock + i, FALSE);
+      #endif
+      #ifdef PRINT_PATHS
+      if (sec->out != NULL && k % PRINT_PATHS == 0)
+         print_path(sec->out, cellBlock + i, TRUE);
+      #endif
+   } else {
+      cellBlock[i].status = CELL_FAILED;
+      if (sec->failed == NULL)
+         progress_cell(i, 1);
+      if (sec->failed != NULL)
+         sec->failed[sec->nFailed++] = k;
+      else if (sec->out != NULL)
+         fprintf(sec->out, "# K %d %d\n",cellBlock[i].p.x, cellBlock[i].p.y);
+      if (inGrid)
+         grid_set_id(grid, cellBlock[i].p.x, cellBlock[i].p.y, GRID_EMPTY);
+   }
+}//grow()
+
+static char *checkpointName = NULL;   // stack -k
+static const char *progressName = NULL;   // stack -t, for the current run
+static long progressResumeLength = -1;    // of the -t file at the checkpoint resumed from
+static FILE *reportFile = NULL;           // the report of the current run
+static time_t lastCheckpoint;
+
+/*
+** Save a checkpoint with cellOrder[next] the next cell to grow, if one is
+** wanted and (unless force) CHECKPOINT_SECS have passed since the last.
+** The report is flushed first and its length recorded, with the progress
+** file's, so a resumed run can cut off what was reported after the
+** checkpoint rather than repeat it.
 */
+static void
+take_checkpoint(int next, Sector *whole, int force) {
+   if (checkpointName == NULL)
+      return;
+   if (!force && time(NULL) - lastCheckpoint < CHECKPOINT_SECS)
+      return;
+   long reportLength = -1;
+   if (reportFile != NULL) {
+      fflush(reportFile);
+      reportLength = ftell(reportFile);
+   }
+   if (checkpoint_write(checkpointName, whole->grid, next, reportLength, progress_length()) != 0)
+      perror(checkpointName);     // carry on: the previous checkpoint is still there
+   lastCheckpoint = time(NULL);
+}//take_checkpoint()
 
 /*
-** For each cell in cellBlock (in order of increasing dist from ONH)
-**   If within START_DIST, make a one node path
-**   else find the closest completed and join paths with it
+** grow() cellOrder[from..numCells-1] in batches of SPEC_BATCH.
+** First the pool's workers speculate() on every cell of the batch against the
+** grid as it was at the start of the batch; then the cells are grown in order,
+** with the grid logging each pixel it changes. A cell's prediction is only
+** used if no logged pixel lies within the distance that decided it, so the
+** result is identical to growing every cell from scratch.
 */
-void 
-process(int size, Grid **grid) {
-   int i = 0;
+static void
+process_speculative(int from, Sector *sec) {
+   Grid *grid = sec->grid;
+   GridLog log = {0, 0, NULL};
+   Prediction *pred = (Prediction *)calloc(SPEC_BATCH, sizeof(Prediction));
+   int nWorkers = pool_workers();
+   SpecBatch sb = {sec, from, pred, (Exclude *)calloc(nWorkers, sizeof(Exclude))};
+   assert(pred != NULL && sb.ex != NULL);
+
+   for(int b = from ; b < numCells ; b += SPEC_BATCH) {
+      int to = b + SPEC_BATCH < numCells ? b + SPEC_BATCH : numCells;
+
+      grid->log = NULL;
+      take_checkpoint(b, sec, FALSE);
+      sb.from = b;
+      pool_for(to - b, speculate_task, &sb);
+
+      log.len = 0;
+      grid->log = &log;
+      for(int k = b ; k < to ; k++)
+         grow(k, sec, pred + k - b);
+   }
+   grid->log = NULL;
+
+   for(int w = 0 ; w < nWorkers ; w++) {
+      free(sb.ex[w].cells.table);
+      free(sb.ex[w].fakes.table);
+   }
+   for(int i = 0 ; i < SPEC_BATCH ; i++)
+      free(pred[i].seg);
+   free(sb.ex);
+   free(pred);
+   free(log.p);
+}//process_speculative()
+
+static int firstGrown;  // cellOrder[0..firstGrown-1] are start cells (or never grown)
+
+/*
+** Pool task: grow every cell of wedge s (see sector.h).
+** Start cells already have their path, and only need indexing.
+*/
+static void
+grow_sector(void *arg, int s, int worker) {
+   Sector *sec = (Sector *)arg + s;
+   sector_fill(sec);
+   for(int j = 0 ; j < sec->nCells ; j++) {
+      int k = sec->cells[j];
+      if (k >= firstGrown)
+         grow(k, sec, NULL);
+      else if (cellBlock[cellOrder[k]].path != NO_NODE)
+         spatial_insert(sec->spatial, cellBlock + cellOrder[k], FIRST_CELL_ID + cellOrder[k]);
+   }
+}//grow_sector()
+
+/*
+** Grow SECTORS wedges as pool tasks, merge them back into whole,
+** then grow the cells that failed again on the whole retina.
+*/
+static void
+process_sectors(Sector *whole) {
+   Sector *sectors = sectors_split(whole);
+
+   pool_for(SECTORS, grow_sector, sectors);
+
+   sectors_merge(sectors, whole);
+   fprintf(stderr, "# %d cells to grow again after merging sectors\n", whole->nCells);
+   for(int j = 0 ; j < whole->nCells ; j++)
+      grow(whole->cells[j], whole, NULL);
+   free(whole->cells);
+   whole->cells  = NULL;
+   whole->nCells = 0;
+}//process_sectors()
+
+/*
+** Give each cell within START_DIST of the ONH, from the start of cellOrder,
+** a one node path. Returns the cellOrder index of the first cell to grow.
+*/
+int
+make_start_cells(Sector *whole) {
+   int k = 0;
    float distToOnh = 0;
-   for( ; i < numCells && distToOnh < START_DIST ; i++) {
+   for( ; k < numCells && distToOnh < START_DIST ; k++) {
+      int i = cellOrder[k];
       Point po = {ONH_X, ONH_Y};
       double theta = atan2((double) cellBlock[i].p.y - (double)ONH_Y, (double) cellBlock[i].p.x - (double)ONH_X);
       distToOnh = DIST(cellBlock[i].p,po) - ONH_EDGE(theta);
 
       if (distToOnh < START_DIST) {
             // just put self in path
-         cellBlock[i].path             = (Node *)malloc(sizeof(Node));
-         cellBlock[i].path->c          = cellBlock + i;
-         cellBlock[i].path->next       = NULL;
-         cellBlock[i].thickness        = 10000000; // UINT_MAX - 1;
+         cellBlock[i].path             = new_node(whole->id, FIRST_CELL_ID + i, NO_NODE);
+         roomBlock[i].thickness        = THICK_UNLIMITED;
+         cellBlock[i].status           = CELL_START;
+         if (SECTORS == 1)
+            spatial_insert(whole->spatial, cellBlock + i, FIRST_CELL_ID + i);
          #ifdef PRINT_ENDPOINTS
-         printf("# S ");
-         print_path(cellBlock + i, FALSE);
+         if (whole->out != NULL) {
+            fprintf(whole->out, "# S ");
+            print_path(whole->out, cellBlock + i, FALSE);
+         }
          #endif
       }
    }
+   return k;
+}//make_start_cells()
 
-   for( ; i < numCells ; i++) {
-      if (cellBlock[i].p.x > 14000) continue;
-      //if (cellBlock[i].p.x > ONH_X) continue;
-      //if (cellBlock[i].p.x < 5000) continue;
-      //if (cellBlock[i].p.y < 5000) continue;
-      //if (cellBlock[i].p.y > 15000) continue;
-      //Cell *closest = cellBlock + findClosestCompleted(i);
-      Cell *closest = findClosestCompleted(i, grid);
-      if (closest == NULL) {
-         printf("# Kn %d %d\n",cellBlock[i].p.x,cellBlock[i].p.y);
-         continue;
+/*
+** For each cell in cellOrder (in order of increasing dist from ONH)
+**   If within START_DIST, make a one node path
+**   else find the closest completed and join paths with it
+** If resumeAt > 0, carry on from a checkpoint with cellOrder[resumeAt].
+** Checkpoints are taken once the start cells are done, then every
+** CHECKPOINT_SECS (but not while SECTORS are growing).
+** Progress is reported to progressName, if it is not NULL (see progress.h).
+*/
+void 
+process(int size, Sector *whole, int resumeAt) {
+   int k = resumeAt == 0 ? make_start_cells(whole) : resumeAt;
+
+   firstGrown = k;
+   progress_start(progressName, numCells - k, resumeAt == 0 ? -1 : progressResumeLength);
+   if (resumeAt == 0)
+      take_checkpoint(k, whole, TRUE);
+   else
+      lastCheckpoint = time(NULL);
+   if (SECTORS > 1)
+      process_sectors(whole);
+   else if (pool_workers() > 1)
+      process_speculative(k, whole);
+   else
+      for( ; k < numCells ; k++) {
+         take_checkpoint(k, whole, FALSE);
+         grow(k, whole, NULL);
       }
-      if (makeOnePath(i, closest, grid)) { 
-         #ifdef PRINT_ENDPOINTS
-         print_path(cellBlock + i, FALSE);
-         #endif
-         #ifdef PRINT_PATHS
-         if (i % PRINT_PATHS == 0)
-            print_path(cellBlock + i, TRUE);
-         #endif
-      } else {
-         printf("# K %d %d\n",cellBlock[i].p.x, cellBlock[i].p.y);
-         grid[cellBlock[i].p.x][cellBlock[i].p.y].soma = NULL;
+
+   progress_stop();
+}//process()
+
+#ifndef BENCH   // bench.c and check.c have their own main()
+
+static double octRadii[OCT_RADII];   // stack --oct, in mm
+static int numOctRadii = 0;
+
+/*
+** The parameters at the top of each report.
+*/
+static void
+print_params(FILE *f) {
+   fprintf(f,"# SEED                  %10d\n",params.seed);
+   if (PIXELS_PER_MM != FULL_PIXELS_PER_MM)
+      fprintf(f,"# PIXELS_PER_MM         %10d (preview)\n",PIXELS_PER_MM);
+   fprintf(f,"# DENSE_SCALE           %10.4f\n",DENSE_SCALE);
+   fprintf(f,"# MAX_THICK             %10d\n",MAX_THICK);
+   fprintf(f,"# MACULAR_RADIUS        %10.4f mm\n",(float)MACULAR_RADIUS/(float)PIXELS_PER_MM);
+   fprintf(f,"# THETA_LIMIT           %10.4f degrees\n",THETA_LIMIT*180.0/M_PI);
+   fprintf(f,"# NEW_PATH_RADIUS_LIMIT %10.4f\n",NEW_PATH_RADIUS_LIMIT);
+   fprintf(f,"# ONH_X                 %10d\n",ONH_X);
+   fprintf(f,"# ONH_Y                 %10d\n",ONH_Y);
+   fprintf(f,"# MAJOR AXIS            %10d\n",ONH_MAJOR);
+   fprintf(f,"# MINOR AXIS            %10d\n",ONH_MINOR);
+   if (POISSON_CELLS)
+      fprintf(f,"# POISSON_CELLS         %10d\n",POISSON_CELLS);
+}//print_params()
+
+/*
+** Make scanPoints, scanTable and an empty *spatial for grid and the current
+** params. prev (NULL the first time) holds the params they were last made
+** for; if the search radius and grid have not changed they are kept (*spatial
+** emptied).
+*/
+static void
+prepare_search(Grid *grid, Spatial **spatial, const Params *prev) {
+   if (prev != NULL && prev->newPathRadiusLimit == params.newPathRadiusLimit && prev->pixelsPerMM == params.pixelsPerMM) {
+      spatial_clear(*spatial);
+      return;
+   }
+   if (prev != NULL) {
+      spatial_free(*spatial);
+      scan_table_free(scanTable);
+      scan_points_free();
+   }
+   stats_phase_start(PHASE_INIT_SCAN);
+   init_scanPoints();
+   stats_phase_stop(PHASE_INIT_SCAN);
+   scanTable = scan_table_new(scanPoints, scanPointLen);
+   *spatial = spatial_new(grid, scanPoints, scanPointLen, (int)NEW_PATH_RADIUS_LIMIT);
+}//prepare_search()
+
+/*
+** Get everything ready to grow with the current params: cells, *grid (made
+** if NULL), and the search tables. prev (NULL the first time) holds the params
+** of the last run: its cells are reused unless params moves them (see
+** params_same_cells()), as are the search tables unless the radius changed.
+*/
+static void
+prepare(int *size, Grid **grid, Spatial **spatial, const Params *prev) {
+   if (prev != NULL && params_same_cells(prev, &params))
+      reset_cells();
+   else {
+      stats_phase_start(PHASE_INIT_GRID);
+      init_grid(size, grid);
+      stats_phase_stop(PHASE_INIT_GRID);
+      stats_phase_start(PHASE_INIT_CELLS);
+      init_cells();
+      stats_phase_stop(PHASE_INIT_CELLS);
+   }
+   cells_reset();
+   prepare_search(*grid, spatial, prev);
+}//prepare()
+
+/*
+** Write the phase times and whole's counters to statsName (see stats.h),
+** and start the phase times again. Returns 0, or 1 if that fails.
+*/
+static int
+write_stats(const char *statsName, const Sector *whole) {
+   FILE *f = fopen(statsName, "w");
+   if (f == NULL) {
+      perror(statsName);
+      return 1;
+   }
+   stats_write(f, &whole->stats);
+   stats_phase_reset();
+   if (fclose(f) != 0) {
+      perror(statsName);
+      return 1;
+   }
+   return 0;
+}//write_stats()
+
+/*
+** Grow the retina in grid, from cellOrder[resumeAt] if not 0. out gets the
+** parameters, unless quiet, each cell's path, and the circle scans of
+** octRadii; the path file is written to pathFileName, the RNFL raster to
+** rnflName, the timings and counters to statsName and progress records to
+** progName if they are not NULL. Returns 0, or 1 if that fails.
+*/
+static int
+run(FILE *out, int quiet, int size, Grid *grid, Spatial *spatial, int resumeAt, const char *pathFileName,
+    const char *rnflName, const char *statsName, const char *progName) {
+   print_params(out);
+   fprintf(out, "# Number of cells: %d\n",numCells);
+   if (resumeAt > 0)
+      fprintf(out, "# Resumed from %s at cell %d\n", checkpointName, resumeAt);
+
+   Sector *whole = sector_new(NUM_ARENAS - 1, grid, spatial);
+   whole->out = quiet ? NULL : out;
+   reportFile = out;
+   progressName = progName;
+   stats_phase_start(PHASE_PROCESS);
+   process(size, whole, resumeAt);
+   stats_phase_stop(PHASE_PROCESS);
+
+   int result = 0;
+   if (rnflName != NULL || numOctRadii > 0) {
+      stats_phase_start(PHASE_RNFL);
+      if (rnfl_write(rnflName, out, octRadii, numOctRadii) != 0) {
+         perror(rnflName);
+         result = 1;
       }
+      stats_phase_stop(PHASE_RNFL);
    }
-   #ifdef PRINT_OCT_PROFILE
-   print_oct(grid, 3.4/2.0);
-   #endif
+   fflush(out);
 
-}//process()
+   if (statsName != NULL && write_stats(statsName, whole) != 0)
+      result = 1;
+   free(whole);
+
+   if (pathFileName != NULL && pathfile_write(pathFileName) != 0) {
+      perror(pathFileName);
+      return 1;
+   }
+   return result;
+}//run()
+
+/*
+** One run per line of file sweepName, each line a list of NAME=value (see
+** params.h) applied to the parameters given on the command line.
+** Run k reports to outName.k, and writes its path file to pathFileName.k,
+** its raster to rnflName.k, its stats to statsName.k and its progress to
+** progName.k.
+** Returns 0, or 1 if a line is wrong or a file cannot be written.
+*/
+static int
+sweep(const char *sweepName, const char *outName, const char *pathFileName, const char *rnflName, const char *statsName,
+      const char *progName, int quiet) {
+   FILE *f = fopen(sweepName, "r");
+   if (f == NULL) {
+      perror(sweepName);
+      return 1;
+   }
+
+   Params base = params, prev;
+   int size;
+   Grid *grid = NULL;
+   Spatial *spatial = NULL;
+   char line[1024], name[1024], binName[1024], rnflFile[1024], statsFile[1024], progFile[1024];
+   int result = 0;
+   for(int k = 1 ; result == 0 && fgets(line, sizeof(line), f) != NULL ; ) {
+      line[strcspn(line, "#\r\n")] = '\0';
+      params = base;
+      int n = 0;
+      for(char *tok = strtok(line, " \t") ; tok != NULL && result == 0 ; tok = strtok(NULL, " \t"), n++)
+         if (params_set(&params, tok) != 0) {
+            fprintf(stderr, "%s: bad run %d\n", sweepName, k);
+            result = 1;
+         }
+      if (n == 0 || result != 0)
+         continue;
+      if (params_check(&params) != 0) {
+         fprintf(stderr, "%s: bad run %d\n", sweepName, k);
+         result = 1;
+         continue;
+      }
+
+      fprintf(stderr, "# Sweep run %d\n", k);
+      pool_start(params.threads);
+      prepare(&size, &grid, &spatial, k == 1 ? NULL : &prev);
+      prev = params;
+
+      snprintf(name, sizeof(name), "%s.%d", outName, k);
+      FILE *out = fopen(name, "w");
+      if (out == NULL) {
+         perror(name);
+         result = 1;
+         continue;
+      }
+      fprintf(out, "# Sweep %s run %d\n", sweepName, k);
+      snprintf(binName, sizeof(binName), "%s.%d", pathFileName == NULL ? "" : pathFileName, k);
+      snprintf(rnflFile, sizeof(rnflFile), "%s.%d", rnflName == NULL ? "" : rnflName, k);
+      snprintf(statsFile, sizeof(statsFile), "%s.%d", statsName == NULL ? "" : statsName, k);
+      snprintf(progFile, sizeof(progFile), "%s.%d", progName == NULL ? "" : progName, k);
+      result = run(out, quiet, size, grid, spatial, 0, pathFileName == NULL ? NULL : binName,
+                   rnflName == NULL ? NULL : rnflFile, statsName == NULL ? NULL : statsFile,
+                   progName == NULL ? NULL : progFile);
+      fclose(out);
+      k++;
+   }
+   fclose(f);
+   return result;
+}//sweep()
 
 /*
-** 
+** Usage: stack [-c file] [-p NAME=value]... [-o file] [-b file] [-r file] [-j file] [-q]
+**              [--oct mm]... [-t file] [-s dir] [-k file [--resume] | --sweep file]
+**    -c file       read parameters from file (see params.h)
+**    -p NAME=value set a parameter (after any -c before it)
+**    -o file       report to file rather than stdout
+**    -b file       also write every cell and its full path to file (see pathfile.h)
+**    -r file       also write the RNFL thickness raster to file (see rnfl.h)
+**    -j file       write phase timings and search counters to file as JSON (see stats.h)
+**    -q            do not report each cell's path
+**    --oct mm      report the OCT circle scan of radius mm around the ONH (up to OCT_RADII)
+**    -t file       add a progress record to file every so often while growing (see progress.h)
+**    -k file       checkpoint to file, removed once the run is done (see checkpoint.h)
+**    -s dir        keep a cache of search offsets in dir (default none; see init_scanPoints())
+**    --resume      carry on, with its parameters, from the checkpoint in the -k file, cutting
+**                  the -o and -t files back to where they were at the checkpoint
+**    --sweep file  a run for each line of file (see sweep())
 */
 int
-main() {
+main(int argc, char *argv[]) {
+   char *pathFileName = NULL;
+   char *rnflName = NULL;
+   char *statsName = NULL;
+   char *progName = NULL;
+   char *outName = NULL;
+   char *sweepName = NULL;
+   int quiet = 0;
+   int resume = 0;
+   int bad = 0;
+   params_default(&params);
+   for(int a = 1 ; a < argc && !bad ; a++) {
+      if (strcmp(argv[a], "-c") == 0 && a + 1 < argc)
+         bad = params_read(&params, argv[++a]) != 0;
+      else if (strcmp(argv[a], "-p") == 0 && a + 1 < argc)
+         bad = params_set(&params, argv[++a]) != 0;
+      else if (strcmp(argv[a], "-o") == 0 && a + 1 < argc)
+         outName = argv[++a];
+      else if (strcmp(argv[a], "-b") == 0 && a + 1 < argc)
+         pathFileName = argv[++a];
+      else if (strcmp(argv[a], "-r") == 0 && a + 1 < argc)
+         rnflName = argv[++a];
+      else if (strcmp(argv[a], "--oct") == 0 && a + 1 < argc && numOctRadii < OCT_RADII)
+         bad = (octRadii[numOctRadii++] = atof(argv[++a])) <= 0;
+      else if (strcmp(argv[a], "-j") == 0 && a + 1 < argc)
+         statsName = argv[++a];
+      else if (strcmp(argv[a], "-q") == 0)
+         quiet = 1;
+      else if (strcmp(argv[a], "-t") == 0 && a + 1 < argc)
+         progName = argv[++a];
+      else if (strcmp(argv[a], "-s") == 0 && a + 1 < argc)
+         scanCacheDir = argv[++a];
+      else if (strcmp(argv[a], "-k") == 0 && a + 1 < argc)
+         checkpointName = argv[++a];
+      else if (strcmp(argv[a], "--resume") == 0)
+         resume = 1;
+      else if (strcmp(argv[a], "--sweep") == 0 && a + 1 < argc)
+         sweepName = argv[++a];
+      else
+         bad = 1;
+   }
+   if (bad || (resume && checkpointName == NULL) || (sweepName != NULL && checkpointName != NULL)) {
+      fprintf(stderr, "Usage: %s [-c file] [-p NAME=value]... [-o file] [-b file] [-r file] [-j file] [-q]\n", argv[0]);
+      fprintf(stderr, "          [--oct mm]... [-t file] [-s dir] [-k file [--resume] | --sweep file]\n");
+      return 1;
+   }
+   if (!resume && sweepName == NULL && params_check(&params) != 0)   // a checkpoint's were checked, a sweep checks each run
+      return 1;
+   if (params.seed == 0)
+      params.seed = (int)(time(NULL) & 0x7fffffff);
+
+
 #ifdef G_THREADS_ENABLED
    fprintf(stderr,"# threads enabled\n");
 #else
@@ -434,37 +1234,52 @@ main() {
    fprintf(stderr,"# threads not posix\n");
 #endif
 
-   fprintf(stdout,"# DENSE_SCALE           %10.4f\n",DENSE_SCALE);
-   fprintf(stdout,"# MAX_THICK             %10d\n",MAX_THICK);
-   fprintf(stdout,"# MACULAR_RADIUS        %10.4f mm\n",(float)MACULAR_RADIUS/(float)PIXELS_PER_MM);
-   fprintf(stdout,"# THETA_LIMIT           %10.4f degrees\n",THETA_LIMIT*180.0/M_PI);
-   fprintf(stdout,"# NEW_PATH_RADIUS_LIMIT %10.4f\n",NEW_PATH_RADIUS_LIMIT);
-   fprintf(stdout,"# ONH_X                 %10d\n",ONH_X);
-   fprintf(stdout,"# ONH_Y                 %10d\n",ONH_Y);
-   fprintf(stdout,"# MAJOR AXIS            %10d\n",ONH_MAJOR);
-   fprintf(stdout,"# MINOR AXIS            %10d\n",ONH_MINOR);
+   pool_start(params.threads);
 
-   g_thread_init(NULL);
-   gdk_threads_init();     /* Secure gtk */
-   gdk_threads_enter();    /* Obtain gtk's global lock */
-
-   int size;
-   Grid **grid;
-   init_grid(&size, &grid);
-
-   init_cells();
+   cells_init();
+   int result;
+   if (sweepName != NULL)
+      result = sweep(sweepName, outName == NULL ? sweepName : outName, pathFileName, rnflName, statsName, progName, quiet);
+   else {
+      int size;
+      Grid *grid = NULL;
+      Spatial *spatial = NULL;
+      int resumeAt = 0;
+      long reportLength = -1;
+      if (resume) {
+         if (checkpoint_read(checkpointName, &grid, &resumeAt, &reportLength, &progressResumeLength) != 0) {
+            perror(checkpointName);
+            return 1;
+         }
+         size = grid->size;
+         prepare_search(grid, &spatial, NULL);
+         spatial_rebuild(spatial);
+      } else
+         prepare(&size, &grid, &spatial, NULL);
 
-   init_scanPoints();
+         // a resumed report goes on from the checkpoint (see checkpoint_reopen())
+      FILE *out = stdout;
+      if (outName != NULL && (out = resume ? checkpoint_reopen(outName, reportLength) : fopen(outName, "w")) == NULL) {
+         perror(outName);
+         return 1;
+      }
 
 //for(int i = 0 ; i < numCells ; i++)
 //if (MACULAR_DIST(cellBlock[i].p) < MACULAR_RADIUS)
 //printf("im %d\n",i);
 //return 0;
-   fprintf(stdout, "# Number of cells: %d\n",numCells);
-   process(size, grid);
-
-   /* Release gtk's global lock */
-   gdk_threads_leave();
+      result = run(out, quiet, size, grid, spatial, resumeAt, pathFileName, rnflName, statsName, progName);
+      if (out != stdout && fclose(out) != 0) {
+         perror(outName);
+         result = 1;
+      }
+         // finished, so there is nothing to resume (see checkpoint.h)
+      if (result == 0 && checkpointName != NULL && remove(checkpointName) != 0)
+         perror(checkpointName);
+   }
+   cells_free();
+   pool_stop();
 
-   return 0;
-}
+   return result;
+}//main()
+#endif
@@ -0,0 +1,26 @@
+#ifndef _MAIN_H_
+#define _MAIN_H_
+
+#include "types.h"
+#include "sector.h"
+#include "scan.h"
+
+   // what speculate() expects of a cell and its targets (private to main.c)
+struct prediction;
+struct segment;
+
+int in_fovea(int x, int y);
+int cross_raphe(Point a, Point b);
+
+extern ScanTable *scanTable;   // scanPoints grouped by sector for findNewPath
+
+   // the steps of growth, for bench.c (i is a cellBlock index, k a cellOrder one)
+Cell *findClosestCompleted_restrictedArea(int i, Sector *sec);
+Cell *findClosestCompleted(int i, Sector *sec);
+CellId findNewPath(Cell *current, CellId target, Sector *sec, const struct segment *seg, int logLen);
+int makeOnePath(int icc, Cell *target, Sector *sec, const struct prediction *pred);
+int make_start_cells(Sector *whole);
+void grow(int k, Sector *sec, struct prediction *pred);
+void process(int size, Sector *whole, int resumeAt);
+
+#endif
@@ -0,0 +1,180 @@
+/*
+** Run time model parameters: see params.h
+*/
+
+#define _POSIX_C_SOURCE 200809L   // for sysconf() under -std=c99
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+#include "setup.h"
+#include "density.h"
+#include "params.h"
+
+Params params;
+
+typedef struct paramDef {
+   const char *name;
+   size_t offset;
+   char isInt;
+   double min;       // smallest allowed value
+   double max;       // largest, or 0 for no limit
+} ParamDef;
+
+static const ParamDef paramDefs[] = {
+   {"DENSE_SCALE",           offsetof(Params, denseScale),      0, 0,   0},
+   {"MAX_THICK",             offsetof(Params, maxThick),        1, 1,   THICK_UNLIMITED - 1},   // 16 bits in CellRoom
+   {"MACULAR_RADIUS",        offsetof(Params, macularRadiusMM), 0, 0,   0},
+   {"THETA_LIMIT",           offsetof(Params, thetaLimitDeg),   0, 0,   0},
+   {"NEW_PATH_RADIUS_LIMIT", offsetof(Params, newPathRadiusMM), 0, 0,   0},
+   {"AXIAL_LENGTH",          offsetof(Params, axialLength),     0, 0,   0},
+   {"ONH_X_DEG",             offsetof(Params, onhXDeg),         0, -90, 0},
+   {"ONH_Y_DEG",             offsetof(Params, onhYDeg),         0, -90, 0},
+   {"ONH_WIDTH",             offsetof(Params, onhWidthMM),      0, 0,   0},
+   {"ONH_HEIGHT",            offsetof(Params, onhHeightMM),     0, 0,   0},
+   {"THREADS",               offsetof(Params, threads),         1, 0,   0},
+   {"POISSON_CELLS",         offsetof(Params, poissonCells),    1, 0,   0},
+   {"SEED",                  offsetof(Params, seed),            1, 0,   0},
+   {"PIXELS_PER_MM",         offsetof(Params, pixelsPerMM),     1, 1,   MAX_PIXELS_PER_MM},
+};
+#define NUM_PARAMS (int)(sizeof(paramDefs) / sizeof(paramDefs[0]))
+
+/*
+** The values the macros in setup.h used to have.
+*/
+void
+params_default(Params *p) {
+   memset(p, 0, sizeof(Params));
+   p->denseScale      = 1.2;
+   p->maxThick        = 60;
+   p->macularRadiusMM = 3;
+   p->thetaLimitDeg   = 180;  // or 60
+   p->newPathRadiusMM = 0;    // 0.55 * macular radius
+   p->axialLength     = 25;
+   p->onhXDeg         = 15.0;
+   p->onhYDeg         = 2.0;
+   p->onhWidthMM      = 1.66;
+   p->onhHeightMM     = 1.94;
+   p->pixelsPerMM     = FULL_PIXELS_PER_MM;
+#ifdef THREADS
+   p->threads         = THREADS;
+#else
+   long cpus = sysconf(_SC_NPROCESSORS_ONLN);   // one thread for each of the others
+   p->threads         = cpus > 1 ? (int)cpus - 1 : 0;
+#endif
+   params_derive(p);
+}//params_default()
+
+/*
+** Set the pixel (and radian) values in p from the others (at p's
+** resolution, which need not be that of params).
+*/
+void
+params_derive(Params *p) {
+   double ppm = p->pixelsPerMM;
+   int size   = SIZE_MM * p->pixelsPerMM;
+   p->macularRadius = (int)round(p->macularRadiusMM * ppm);
+   p->thetaLimit    = p->thetaLimitDeg / 180.0 * M_PI;
+   if (p->newPathRadiusMM == 0)
+      p->newPathRadiusLimit = p->macularRadius / 2.0 * 1.1;
+   else
+      p->newPathRadiusLimit = p->newPathRadiusMM * ppm;
+   p->onhX     = (int)((size/2 + (p->onhXDeg / 180.0 * M_PI * p->axialLength / 2.0 * ppm)));
+   p->onhY     = (int)((size/2 + (p->onhYDeg / 180.0 * M_PI * p->axialLength / 2.0 * ppm)));
+   p->onhMajor = (int)(p->onhWidthMM  / 2.0 * ppm);
+   p->onhMinor = (int)(p->onhHeightMM / 2.0 * ppm);
+}//params_derive()
+
+/*
+** Returns 0, or -1 (with a message on stderr) if p's cells would be denser
+** than its pixels somewhere: a pixel holds at most one cell, so some would
+** be lost. The density peaks about 1 mm from the fovea.
+*/
+int
+params_check(const Params *p) {
+   double peak  = density_max(0, SIZE_MM) * p->denseScale;   // cells per mm^2 (SIZE_MM is beyond the corners)
+   double perMM = (double)p->pixelsPerMM * p->pixelsPerMM;  // pixels per mm^2
+   if (peak <= perMM)
+      return 0;
+   fprintf(stderr, "PIXELS_PER_MM %d is too coarse for DENSE_SCALE %g: up to %.0f cells but %.0f pixels per mm^2\n",
+      p->pixelsPerMM, p->denseScale, peak, perMM);
+   fprintf(stderr, "   (use PIXELS_PER_MM %d or more, or a DENSE_SCALE of %g or less)\n",
+      (int)ceil(sqrt(peak)), floor(perMM / peak * p->denseScale * 1e4) / 1e4);
+   return -1;
+}//params_check()
+
+/*
+** Apply "NAME=value" (or "NAME value") to p, and derive the rest.
+** Returns 0, or -1 (with a message on stderr) if it is not a valid setting.
+*/
+int
+params_set(Params *p, const char *assignment) {
+   const char *s = assignment;
+   while (isspace((unsigned char)*s)) s++;
+   size_t len = strcspn(s, "= \t");
+   const char *v = s + len;
+   while (isspace((unsigned char)*v)) v++;
+   if (*v == '=') v++;
+
+   for(int i = 0 ; i < NUM_PARAMS ; i++) {
+      const ParamDef *d = paramDefs + i;
+      if (strlen(d->name) != len || strncmp(d->name, s, len) != 0)
+         continue;
+      char *end;
+      double x = strtod(v, &end);
+      while (isspace((unsigned char)*end)) end++;
+      if (end == v || *end != '\0' || x < d->min || (d->max != 0 && x > d->max) || (d->isInt && x != floor(x))) {
+         fprintf(stderr, "Bad value for %s in \"%s\"\n", d->name, assignment);
+         return -1;
+      }
+      if (d->isInt)
+         *(int *)((char *)p + d->offset) = (int)x;
+      else
+         *(double *)((char *)p + d->offset) = x;
+      params_derive(p);
+      return 0;
+   }
+
+   fprintf(stderr, "Unknown parameter in \"%s\"\n", assignment);
+   return -1;
+}//params_set()
+
+/*
+** Apply every setting in config file fileName to p.
+** Returns 0, or -1 (with a message on stderr) if it cannot be read or is wrong.
+*/
+int
+params_read(Params *p, const char *fileName) {
+   FILE *f = fopen(fileName, "r");
+   if (f == NULL) {
+      perror(fileName);
+      return -1;
+   }
+   char line[1024];
+   int result = 0;
+   while (result == 0 && fgets(line, sizeof(line), f) != NULL) {
+      line[strcspn(line, "#\r\n")] = '\0';
+      char *s = line;
+      while (isspace((unsigned char)*s)) s++;
+      if (*s != '\0')
+         result = params_set(p, s);
+   }
+   fclose(f);
+   return result;
+}//params_read()
+
+/*
+** 1 if a and b place the same cells in the same grid (given the same random
+** numbers), so a run with b can start from the cells made for a.
+*/
+int
+params_same_cells(const Params *a, const Params *b) {
+   return a->pixelsPerMM == b->pixelsPerMM && a->denseScale == b->denseScale
+       && a->onhX == b->onhX && a->onhY == b->onhY
+       && a->onhMajor == b->onhMajor && a->onhMinor == b->onhMinor
+       && a->poissonCells == b->poissonCells && a->seed == b->seed;
+}//params_same_cells()
@@ -0,0 +1,74 @@
+#ifndef _PARAMS_H_
+#define _PARAMS_H_
+
+#include <stdio.h>
+
+/*
+** Model parameters that can be set at run time, from a config file (-c) or
+** the command line (-p NAME=value), by the names below. setup.h maps the
+** old macros (DENSE_SCALE, ONH_X, ...) onto params, so code uses them as before.
+**
+** A config file has one NAME=value (or NAME value) per line; # starts a comment.
+**
+**    DENSE_SCALE            multiply density by this factor
+**    MAX_THICK              most paths through a cell at MACULAR_RADIUS and beyond
+**    MACULAR_RADIUS         mm
+**    THETA_LIMIT            degrees either side of the direction of growth to search
+**    NEW_PATH_RADIUS_LIMIT  mm to search for a cell to join; 0 for 0.55 * MACULAR_RADIUS
+**    AXIAL_LENGTH           mm
+**    ONH_X_DEG, ONH_Y_DEG   degrees from the fovea to the centre of the ONH
+**    ONH_WIDTH, ONH_HEIGHT  mm
+**    THREADS                number of EXTRA threads to use (default -DTHREADS, or
+**                           one per core less the main thread)
+**    SEED                   of the random numbers that place the cells; 0 (the
+**                           default) for one from the clock, printed in the output
+**    POISSON_CELLS          1 to place cells with a Poisson draw per tile (time
+**                           grows with cells, not pixels); 0 for a trial per pixel
+**    PIXELS_PER_MM          resolution of the grid (default 1000, at most
+**                           MAX_PIXELS_PER_MM). Lower it for a quick preview:
+**                           250 is a 4x coarser grid, with 16x fewer pixels.
+**                           Everything given in mm scales with it and cells per
+**                           mm^2 stay the same; MAX_THICK is paths per cell, so
+**                           it does not change. A pixel holds one cell, so a run
+**                           whose cells would be denser than its pixels (below
+**                           about 195 at DENSE_SCALE 1.2) is refused rather than
+**                           losing some: lower DENSE_SCALE too for a coarser
+**                           preview (see params_check()).
+*/
+
+typedef struct params {
+   double denseScale;
+   double macularRadiusMM;
+   double thetaLimitDeg;
+   double newPathRadiusMM;
+   double axialLength;
+   double onhXDeg;
+   double onhYDeg;
+   double onhWidthMM;
+   double onhHeightMM;
+   int maxThick;
+   int threads;
+   int poissonCells;
+   int seed;
+   int pixelsPerMM;
+
+      // in pixels (or radians), set from the above by params_derive()
+   double thetaLimit;
+   double newPathRadiusLimit;
+   int macularRadius;
+   int onhX;
+   int onhY;
+   int onhMajor;           // half width
+   int onhMinor;           // half height
+} Params;
+
+extern Params params;      // the parameters of the current run
+
+void params_default(Params *p);
+void params_derive(Params *p);
+int params_check(const Params *p);
+int params_set(Params *p, const char *assignment);
+int params_read(Params *p, const char *fileName);
+int params_same_cells(const Params *a, const Params *b);
+
+#endif
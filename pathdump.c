@@ -0,0 +1,109 @@
+/*
+** Print from a path file written by stack -b (see pathfile.h).
+**
+**    pathdump file            summary
+**    pathdump file -e         endpoints, as stack prints them ("# S", "# K", "# Kn")
+**    pathdump file -c i       full path of cell i, ending with -1 -1
+**    pathdump file -p x y     full path of the cell at (x,y)
+**    pathdump file -a         full path of every cell
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include "pathfile.h"
+#include "pathread.h"
+
+static void
+usage(const char *prog) {
+   fprintf(stderr, "Usage: %s file [-e | -c cell | -p x y | -a]\n", prog);
+   exit(1);
+}//usage()
+
+/*
+** Print the path of cell as stack's print_path(full=TRUE) does.
+*/
+static void
+print_full(const PathFile *pf, int cell) {
+   static PfNode *buf = NULL;
+   static int cap = 0;
+   int len;
+   while ((len = pf_path(pf, cell, buf, cap)) > cap) {
+      cap = len;
+      buf = (PfNode *)realloc(buf, sizeof(PfNode) * cap);
+      assert(buf != NULL);
+   }
+   if (len < 0) {
+      fprintf(stderr, "bad path for cell %d\n", cell);
+      exit(1);
+   }
+   for(int k = 0 ; k < len ; k++)
+      printf("%6d %6d\n", buf[k].x, buf[k].y);
+   printf("-1 -1\n");
+}//print_full()
+
+/*
+** Print cell and the end of its path as stack's print_path(full=FALSE) does.
+*/
+static void
+print_end(const PathFile *pf, int cell) {
+   const PfCell *c = pf->cells + cell;
+   switch (c->status) {
+      case PF_START:   printf("# S "); break;
+      case PF_GROWN:   break;
+      case PF_FAILED:  printf("# K %d %d\n", c->x, c->y);  return;
+      case PF_NO_NEAR: printf("# Kn %d %d\n", c->x, c->y); return;
+      default: return;
+   }
+   printf("%6d %6d %6d %6d\n", c->x, c->y, pf->nodes[c->end].x, pf->nodes[c->end].y);
+}//print_end()
+
+int
+main(int argc, char *argv[]) {
+   if (argc < 2)
+      usage(argv[0]);
+
+   PathFile *pf = pf_open(argv[1]);
+   if (pf == NULL) {
+      fprintf(stderr, "%s: cannot read %s: %s\n", argv[0], argv[1], strerror(errno));
+      return 1;
+   }
+   int numCells = (int)pf->h->numCells;
+
+   if (argc == 2) {
+      int n[256] = {0};
+      for(int i = 0 ; i < numCells ; i++)
+         n[(unsigned char)pf->cells[i].status]++;
+      printf("# size %d pixels, %d pixels/mm, ONH (%d,%d)\n", pf->h->size, pf->h->pixelsPerMM, pf->h->onhX, pf->h->onhY);
+      printf("# cells %d: start %d grown %d failed %d no near %d ungrown %d\n", numCells,
+         n[PF_START], n[PF_GROWN], n[PF_FAILED], n[PF_NO_NEAR], n[PF_UNGROWN]);
+      printf("# nodes %u\n", pf->h->numNodes);
+   } else if (strcmp(argv[2], "-e") == 0 && argc == 3) {
+      for(int i = 0 ; i < numCells ; i++)
+         print_end(pf, i);
+   } else if (strcmp(argv[2], "-a") == 0 && argc == 3) {
+      for(int i = 0 ; i < numCells ; i++)
+         if (pf->cells[i].path != 0)
+            print_full(pf, i);
+   } else if (strcmp(argv[2], "-c") == 0 && argc == 4) {
+      int i = atoi(argv[3]);
+      if (i < 0 || i >= numCells) {
+         fprintf(stderr, "%s: no cell %d\n", argv[0], i);
+         return 1;
+      }
+      print_full(pf, i);
+   } else if (strcmp(argv[2], "-p") == 0 && argc == 5) {
+      int i = pf_find(pf, atoi(argv[3]), atoi(argv[4]));
+      if (i < 0) {
+         fprintf(stderr, "%s: no cell at (%s,%s)\n", argv[0], argv[3], argv[4]);
+         return 1;
+      }
+      print_full(pf, i);
+   } else
+      usage(argv[0]);
+
+   pf_close(pf);
+   return 0;
+}//main()
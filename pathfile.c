@@ -0,0 +1,158 @@
+/*
+** Write the binary path file described in pathfile.h.
+**
+** Only nodes reachable from a cell's path are written, numbered in the order
+** they are first met walking each cell's path in cellOrder, so the
+** part of a path that no earlier cell shares is contiguous in the file.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include "setup.h"
+#include "density.h"
+#include "types.h"
+#include "cells.h"
+#include "pathfile.h"
+
+#if CELL_START != PF_START || CELL_GROWN != PF_GROWN || CELL_FAILED != PF_FAILED || CELL_NO_NEAR != PF_NO_NEAR
+#error "Cell.status and PfCell.status differ"
+#endif
+
+static uint32_t base[NUM_ARENAS];    // slot of NodeId n is base[arena] + handle - 1
+
+static size_t
+node_slot(NodeId n) {
+   return (size_t)base[(uint64_t)n >> NODE_SHIFT] + (n & NODE_MASK) - 1;
+}//node_slot()
+
+static int
+cmp_pos(const void *a, const void *b) {
+   Point pa = cellBlock[cellOrder[*(const uint32_t *)a]].p;
+   Point pb = cellBlock[cellOrder[*(const uint32_t *)b]].p;
+   if (pa.x != pb.x)
+      return pa.x - pb.x;
+   return pa.y - pb.y;
+}//cmp_pos()
+
+/*
+** Write n bytes at p to f (none if p is NULL: they have been written
+** already), then pad with zeros to a multiple of 8.
+*/
+static void
+write_section(FILE *f, const void *p, size_t n) {
+   static const char zero[8] = {0};
+   if (p != NULL && n > 0)
+      fwrite(p, 1, n, f);
+   if (n % 8 != 0)
+      fwrite(zero, 1, 8 - n % 8, f);
+}//write_section()
+
+/*
+** Write every cell and its path to file name.
+** The nodes are written as they are numbered, so besides the cells only
+** two numbers per Node are held: its place in the file, and (by place)
+** the end of its path. The header and cells go in last, over the space
+** left for them at the front.
+** Returns 0 on success, -1 (with errno set, ENOMEM if memory ran out) if
+** the file could not be written.
+*/
+int
+pathfile_write(const char *name) {
+   assert(SIZE <= INT16_MAX);
+
+   size_t numSlots = 0;
+   for(int a = 0 ; a < NUM_ARENAS ; a++) {
+      base[a] = (uint32_t)numSlots;
+      numSlots += nodeArenas[a]->next - 1;
+   }
+
+   FILE *f = fopen(name, "wb");
+   if (f == NULL)
+      return -1;
+   setvbuf(f, NULL, _IOFBF, 1 << 20);
+
+   uint32_t *fileIndex = (uint32_t *)calloc(numSlots + 1, sizeof(uint32_t));   // by slot, 0 if not met yet
+   uint32_t *end = (uint32_t *)malloc(sizeof(uint32_t) * (numSlots + 1));      // by file index
+   PfCell *cells = (PfCell *)calloc(numCells, sizeof(PfCell));
+   uint32_t *byPos = (uint32_t *)malloc(sizeof(uint32_t) * numCells);
+   if (fileIndex == NULL || end == NULL || cells == NULL || byPos == NULL) {
+      free(fileIndex);
+      free(end);
+      free(cells);
+      free(byPos);
+      fclose(f);
+      remove(name);
+      errno = ENOMEM;
+      return -1;
+   }
+
+   PfHeader h;
+   memset(&h, 0, sizeof(h));
+   h.cellsOffset = (sizeof(h) + 7) / 8 * 8;
+   h.nodesOffset = h.cellsOffset + ((uint64_t)sizeof(PfCell) * numCells + 7) / 8 * 8;
+   fseek(f, (long)h.nodesOffset, SEEK_SET);
+   PfNode node = {0, 0, 0};
+   fwrite(&node, sizeof(node), 1, f);         // nodes[0], unused
+
+      // number reachable nodes, writing each new run of a path as it is met
+   uint32_t numNodes = 0;
+   for(int i = 0 ; i < numCells ; i++) {
+      Cell *c = cellBlock + cellOrder[i];
+      CellRoom *r = roomBlock + cellOrder[i];
+      uint32_t first = numNodes + 1;
+      NodeId n = c->path;
+      for( ; n != NO_NODE && fileIndex[node_slot(n)] == 0 ; n = NODE(n)->next)
+         fileIndex[node_slot(n)] = ++numNodes;
+      uint32_t joins = n != NO_NODE ? fileIndex[node_slot(n)] : 0;   // where the new run goes on to
+      uint32_t e = joins != 0 ? end[joins] : numNodes;
+      NodeId m = c->path;
+      for(uint32_t k = first ; k <= numNodes ; k++, m = NODE(m)->next) {
+         Point p = CELL(NODE(m)->c)->p;
+         node.x    = p.x;
+         node.y    = p.y;
+         node.next = k < numNodes ? k + 1 : joins;
+         fwrite(&node, sizeof(node), 1, f);
+         end[k] = e;
+      }
+
+      cells[i].x         = c->p.x;
+      cells[i].y         = c->p.y;
+      cells[i].status    = c->status;
+      cells[i].path      = c->path == NO_NODE ? 0 : fileIndex[node_slot(c->path)];
+      cells[i].end       = c->path == NO_NODE ? 0 : end[cells[i].path];
+      cells[i].count     = r->count;
+      cells[i].thickness = r->thickness == THICK_UNLIMITED ? PF_UNLIMITED : r->thickness;
+   }
+   free(end);
+   free(fileIndex);
+   write_section(f, NULL, sizeof(PfNode) * (numNodes + 1));   // pad the nodes
+
+   for(int i = 0 ; i < numCells ; i++)
+      byPos[i] = i;
+   qsort(byPos, numCells, sizeof(uint32_t), cmp_pos);
+   write_section(f, byPos, sizeof(uint32_t) * numCells);
+
+   memcpy(h.magic, PF_MAGIC, sizeof(h.magic));
+   h.version     = PF_VERSION;
+   h.endian      = PF_ENDIAN;
+   h.numCells    = numCells;
+   h.numNodes    = numNodes;
+   h.size        = SIZE;
+   h.pixelsPerMM = PIXELS_PER_MM;
+   h.onhX        = ONH_X;
+   h.onhY        = ONH_Y;
+   h.byPosOffset = h.nodesOffset + ((uint64_t)sizeof(PfNode) * (numNodes + 1) + 7) / 8 * 8;
+   fseek(f, 0, SEEK_SET);
+   write_section(f, &h, sizeof(h));
+   write_section(f, cells, sizeof(PfCell) * numCells);
+
+   int result = ferror(f) ? -1 : 0;
+   if (fclose(f) != 0)
+      result = -1;
+   free(byPos);
+   free(cells);
+   return result;
+}//pathfile_write()
@@ -0,0 +1,72 @@
+#ifndef _PATHFILE_H_
+#define _PATHFILE_H_
+
+#include <stdint.h>
+
+/*
+** Binary output of a run: every real cell, its endpoint, and the whole
+** (shared) forest of path Nodes, laid out so the file can be mmap()ed and
+** used in place (see pathread.h).
+**
+**   PfHeader
+**   PfCell  cells[numCells]       in cellOrder (increasing distToOnh)
+**   PfNode  nodes[numNodes + 1]   nodes[0] is unused, next == 0 ends a path
+**   uint32  byPos[numCells]       cell indexes sorted by (x, y)
+**
+** Each section starts on an 8 byte boundary at the offset given in the
+** header. Numbers are in the byte order of the machine that wrote the file
+** (see PF_ENDIAN). The path of cell i is nodes[cells[i].path], then
+** nodes[nodes[..].next] and so on; the first node is the cell itself and
+** the last (cells[i].end) is a start cell next to the ONH (unless the cell
+** failed, when it may keep part of a path). Paths share their tails, so the
+** nodes form a forest with roots at the start cells.
+*/
+
+#define PF_MAGIC   "STACKPF1"
+#define PF_VERSION 1
+#define PF_ENDIAN  0x01020304  // reads as 0x04030201 on a machine of the other byte order
+
+   // PfCell.status
+#define PF_UNGROWN  0     // never grown
+#define PF_START   'S'    // start cell, within START_DIST of the ONH
+#define PF_GROWN   'G'    // has a path to the ONH
+#define PF_FAILED  'K'    // no path could be found
+#define PF_NO_NEAR 'N'    // no completed cell within NEW_PATH_RADIUS_LIMIT
+
+#define PF_UNLIMITED 10000000   // PfCell.thickness of a start cell
+
+typedef struct pfHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t endian;
+   uint32_t numCells;
+   uint32_t numNodes;
+   int32_t size;           // grid is size*size pixels
+   int32_t pixelsPerMM;
+   int32_t onhX;
+   int32_t onhY;
+   uint64_t cellsOffset;
+   uint64_t nodesOffset;
+   uint64_t byPosOffset;
+} PfHeader;
+
+typedef struct pfCell {
+   int16_t x;
+   int16_t y;
+   char status;            // PF_START, ...
+   char pad[3];
+   uint32_t path;          // first node of path (this cell), 0 if none
+   uint32_t end;           // last node of path, 0 if none
+   uint32_t count;         // paths through this cell
+   uint32_t thickness;     // paths allowed through this cell (PF_UNLIMITED for start cells)
+} PfCell;
+
+typedef struct pfNode {
+   int16_t x;
+   int16_t y;
+   uint32_t next;          // next node towards the ONH, 0 if none
+} PfNode;
+
+int pathfile_write(const char *name);
+
+#endif
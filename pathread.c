@@ -0,0 +1,115 @@
+/*
+** Reading path files: see pathread.h
+*/
+
+#define _POSIX_C_SOURCE 200809L   // for mmap() under -std=c99
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pathfile.h"
+#include "pathread.h"
+
+/*
+** 1 if the section of n elements of elemSize at offset fits in a file of len bytes.
+*/
+static int
+fits(uint64_t offset, uint64_t n, size_t elemSize, size_t len) {
+   return offset <= len && offset % 8 == 0 && n <= (len - offset) / elemSize;
+}//fits()
+
+/*
+** Map file name, or return NULL (with errno set) if it cannot be read
+** or is not a path file of this version and byte order.
+*/
+PathFile *
+pf_open(const char *name) {
+   int fd = open(name, O_RDONLY);
+   if (fd < 0)
+      return NULL;
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PfHeader)) {
+      if (errno == 0) errno = EINVAL;
+      close(fd);
+      return NULL;
+   }
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return NULL;
+
+   const PfHeader *h = (const PfHeader *)map;
+   size_t len = st.st_size;
+   if (memcmp(h->magic, PF_MAGIC, sizeof(h->magic)) != 0
+   ||  h->version != PF_VERSION || h->endian != PF_ENDIAN
+   ||  !fits(h->cellsOffset, h->numCells,         sizeof(PfCell),   len)
+   ||  !fits(h->nodesOffset, h->numNodes + 1ULL,  sizeof(PfNode),   len)
+   ||  !fits(h->byPosOffset, h->numCells,         sizeof(uint32_t), len)) {
+      munmap(map, len);
+      errno = EINVAL;
+      return NULL;
+   }
+
+   PathFile *pf = (PathFile *)malloc(sizeof(PathFile));
+   assert(pf != NULL);
+   pf->map   = map;
+   pf->len   = len;
+   pf->h     = h;
+   pf->cells = (const PfCell *)  ((const char *)map + h->cellsOffset);
+   pf->nodes = (const PfNode *)  ((const char *)map + h->nodesOffset);
+   pf->byPos = (const uint32_t *)((const char *)map + h->byPosOffset);
+   return pf;
+}//pf_open()
+
+void
+pf_close(PathFile *pf) {
+   munmap(pf->map, pf->len);
+   free(pf);
+}//pf_close()
+
+/*
+** Index of the cell at (x,y), or -1 if there is none. O(log numCells).
+*/
+int
+pf_find(const PathFile *pf, int x, int y) {
+   uint32_t lo = 0, hi = pf->h->numCells;
+   while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      const PfCell *c = pf->cells + pf->byPos[mid];
+      if (c->x < x || (c->x == x && c->y < y))
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   if (lo < pf->h->numCells) {
+      const PfCell *c = pf->cells + pf->byPos[lo];
+      if (c->x == x && c->y == y)
+         return (int)pf->byPos[lo];
+   }
+   return -1;
+}//pf_find()
+
+/*
+** Copy the path of cell into out[0..max-1], and return its length
+** (which may be more than max: call again with a bigger out).
+** Returns -1 if the file has a loop or a node out of range.
+*/
+int
+pf_path(const PathFile *pf, int cell, PfNode *out, int max) {
+   int len = 0;
+   for(uint32_t n = pf->cells[cell].path ; n != 0 ; n = pf->nodes[n].next) {
+      if (n > pf->h->numNodes || (uint32_t)len > pf->h->numNodes)
+         return -1;
+      if (len < max)
+         out[len] = pf->nodes[n];
+      len++;
+   }
+   return len;
+}//pf_path()
@@ -0,0 +1,27 @@
+#ifndef _PATHREAD_H_
+#define _PATHREAD_H_
+
+#include <stddef.h>
+#include "pathfile.h"
+
+/*
+** Read-only access to a path file (see pathfile.h), mmap()ed in place,
+** so opening is O(1) and only the pages that are touched are read.
+** Needs nothing else from stack.
+*/
+
+typedef struct pathFile {
+   void *map;
+   size_t len;
+   const PfHeader *h;
+   const PfCell *cells;       // h->numCells of them
+   const PfNode *nodes;       // h->numNodes + 1 of them, nodes[0] unused
+   const uint32_t *byPos;     // cell indexes sorted by (x,y)
+} PathFile;
+
+PathFile *pf_open(const char *name);
+void pf_close(PathFile *pf);
+int pf_find(const PathFile *pf, int x, int y);
+int pf_path(const PathFile *pf, int cell, PfNode *out, int max);
+
+#endif
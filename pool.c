@@ -0,0 +1,189 @@
+/*
+** Work stealing thread pool: see pool.h
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <glib.h>
+#include "pool.h"
+
+typedef struct poolRange {
+   GMutex lock;
+   int next, end;       // indices next..end-1 are still to be done by this worker
+} PoolRange;
+
+static struct {
+   int nWorkers;        // 0 until pool_start()
+   GThread **threads;   // threads[w-1] is worker w; worker 0 calls pool_for()
+   PoolRange *ranges;
+   GMutex lock;         // for the fields below
+   GCond go, done;
+   int job;             // count of pool_for() calls
+   int busy;            // threads still working on the current job
+   int quit;
+   int running;         // in pool_for()
+   PoolTask task;
+   void *arg;
+} pool;
+
+/*
+** Take an index for worker w: its own next, or else the top half of the
+** biggest share left, of which it does the first and keeps the rest.
+** Returns -1 when there is nothing left anywhere.
+*/
+static int
+take(int w) {
+   PoolRange *own = pool.ranges + w;
+   g_mutex_lock(&own->lock);
+   int i = own->next < own->end ? own->next++ : -1;
+   g_mutex_unlock(&own->lock);
+   if (i >= 0)
+      return i;
+
+   for(int k = 1 ; k < pool.nWorkers ; k++) {
+      PoolRange *v = pool.ranges + (w + k) % pool.nWorkers;
+      g_mutex_lock(&v->lock);
+      int left = v->end - v->next;
+      int from = -1, to = -1;
+      if (left > 0) {
+         from = v->end - (left + 1) / 2;
+         to   = v->end;
+         v->end = from;
+      }
+      g_mutex_unlock(&v->lock);
+      if (from >= 0) {
+         g_mutex_lock(&own->lock);
+         own->next = from + 1;
+         own->end  = to;
+         g_mutex_unlock(&own->lock);
+         return from;
+      }
+   }
+   return -1;
+}//take()
+
+static void
+work(int w) {
+   for(int i = take(w) ; i >= 0 ; i = take(w))
+      pool.task(pool.arg, i, w);
+}//work()
+
+/*
+** Thread body of worker w (1..nWorkers-1): work on each job as it comes.
+*/
+static gpointer
+worker(gpointer data) {
+   int w = (int)(long)data;
+   int seen = 0;
+   g_mutex_lock(&pool.lock);
+   for(;;) {
+      while (pool.job == seen && !pool.quit)
+         g_cond_wait(&pool.go, &pool.lock);
+      if (pool.quit)
+         break;
+      seen = pool.job;
+      g_mutex_unlock(&pool.lock);
+
+      work(w);
+
+      g_mutex_lock(&pool.lock);
+      if (--pool.busy == 0)
+         g_cond_signal(&pool.done);
+   }
+   g_mutex_unlock(&pool.lock);
+   return NULL;
+}//worker()
+
+/*
+** Make the pool nThreads threads (as well as the caller), stopping the
+** old one first if it was a different size.
+*/
+void
+pool_start(int nThreads) {
+   if (pool.nWorkers == nThreads + 1)
+      return;
+   pool_stop();
+
+   pool.nWorkers = nThreads + 1;
+   pool.threads  = (GThread **)malloc(sizeof(GThread *) * pool.nWorkers);
+   pool.ranges   = (PoolRange *)malloc(sizeof(PoolRange) * pool.nWorkers);
+   assert(pool.threads != NULL && pool.ranges != NULL);
+   g_mutex_init(&pool.lock);
+   g_cond_init(&pool.go);
+   g_cond_init(&pool.done);
+   pool.job  = 0;
+   pool.busy = 0;
+   pool.quit = 0;
+   for(int w = 0 ; w < pool.nWorkers ; w++) {
+      g_mutex_init(&pool.ranges[w].lock);
+      pool.ranges[w].next = pool.ranges[w].end = 0;
+   }
+   for(int w = 1 ; w < pool.nWorkers ; w++)
+      pool.threads[w - 1] = g_thread_new("pool", worker, (gpointer)(long)w);   // aborts if it cannot
+}//pool_start()
+
+/*
+** Stop and join the threads, if any.
+*/
+void
+pool_stop() {
+   if (pool.nWorkers == 0)
+      return;
+   g_mutex_lock(&pool.lock);
+   pool.quit = 1;
+   g_cond_broadcast(&pool.go);
+   g_mutex_unlock(&pool.lock);
+   for(int w = 1 ; w < pool.nWorkers ; w++)
+      g_thread_join(pool.threads[w - 1]);
+
+   for(int w = 0 ; w < pool.nWorkers ; w++)
+      g_mutex_clear(&pool.ranges[w].lock);
+   g_mutex_clear(&pool.lock);
+   g_cond_clear(&pool.go);
+   g_cond_clear(&pool.done);
+   free(pool.ranges);
+   free(pool.threads);
+   pool.nWorkers = 0;
+}//pool_stop()
+
+/*
+** Number of workers, so the size of per worker scratch (1 if not started).
+*/
+int
+pool_workers() {
+   return pool.nWorkers == 0 ? 1 : pool.nWorkers;
+}//pool_workers()
+
+/*
+** task(arg, i, worker) for i in [0, n), returning when all are done.
+*/
+void
+pool_for(int n, PoolTask task, void *arg) {
+   if (pool.nWorkers <= 1 || n <= 1) {
+      for(int i = 0 ; i < n ; i++)
+         task(arg, i, 0);
+      return;
+   }
+   assert(!pool.running);
+   pool.running = 1;
+
+   g_mutex_lock(&pool.lock);
+   pool.task = task;
+   pool.arg  = arg;
+   for(int w = 0 ; w < pool.nWorkers ; w++) {
+      pool.ranges[w].next = (int)((long long)n *  w      / pool.nWorkers);
+      pool.ranges[w].end  = (int)((long long)n * (w + 1) / pool.nWorkers);
+   }
+   pool.busy = pool.nWorkers - 1;
+   pool.job++;
+   g_cond_broadcast(&pool.go);
+   g_mutex_unlock(&pool.lock);
+
+   work(0);
+
+   g_mutex_lock(&pool.lock);
+   while (pool.busy > 0)
+      g_cond_wait(&pool.done, &pool.lock);
+   g_mutex_unlock(&pool.lock);
+   pool.running = 0;
+}//pool_for()
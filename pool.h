@@ -0,0 +1,25 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+
+/*
+** One set of threads kept for the whole run (params.threads of them, plus
+** the thread that calls pool_for()), rather than new threads for each
+** parallel step.
+**
+** pool_for(n, task, arg) runs task(arg, i, worker) for every i in [0, n).
+** Each worker starts on its own share of the range; one that runs out steals
+** half of what is left of another's, so uneven tasks still keep every
+** thread busy. worker (in [0, pool_workers())) is for per thread scratch:
+** no two tasks run at once with the same worker.
+**
+** pool_for() is not re-entrant: a task must not call it.
+*/
+
+typedef void (*PoolTask)(void *arg, int i, int worker);
+
+void pool_start(int nThreads);
+void pool_stop();
+int pool_workers();
+void pool_for(int n, PoolTask task, void *arg);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+** Progress records from a thread of their own: see progress.h
+*/
+
+#define _POSIX_C_SOURCE 200809L   // for clock_gettime() and sysconf() under -std=c99
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <glib.h>
+#include "setup.h"
+#include "cells.h"
+#include "checkpoint.h"
+#include "progress.h"
+
+Progress progress;
+
+static struct {
+   FILE *f;
+   GThread *thread;
+   GMutex lock;         // for quit and wake
+   GCond wake;
+   int quit;
+   int total;
+   double start;        // seconds, at progress_start()
+   double lastT;        // ... at the last record
+   int lastDone;
+} rep;
+
+static double
+now() {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}//now()
+
+/*
+** Resident set size in kilobytes, from /proc if there is one,
+** else the peak so far.
+*/
+static long
+rss_kb() {
+   long pages, resident;
+   FILE *f = fopen("/proc/self/statm", "r");
+   if (f != NULL) {
+      int n = fscanf(f, "%ld %ld", &pages, &resident);
+      fclose(f);
+      if (n == 2)
+         return resident * (sysconf(_SC_PAGESIZE) / 1024);
+   }
+   struct rusage ru;
+   getrusage(RUSAGE_SELF, &ru);
+   return (long)ru.ru_maxrss;
+}//rss_kb()
+
+/*
+** Write a record of where things are now (see progress.h).
+*/
+static void
+record(int end) {
+   double t = now();
+   int done   = g_atomic_int_get(&progress.done);
+   int failed = g_atomic_int_get(&progress.failed);
+   int last   = g_atomic_int_get(&progress.last);
+
+   double rate = t > rep.lastT ? (done - rep.lastDone) / (t - rep.lastT) : 0;
+   double mean = t > rep.start ? done / (t - rep.start) : 0;
+   double eta  = rate > 0 ? (rep.total - done) / rate : -1;
+   double dist = 0;
+   if (done > 0) {
+      Point po = {ONH_X, ONH_Y};
+      Point p = cellBlock[last].p;
+      double theta = atan2((double)p.y - (double)ONH_Y, (double)p.x - (double)ONH_X);
+      dist = (DIST(p, po) - ONH_EDGE(theta)) / PIXELS_PER_MM;
+   }
+   fprintf(rep.f, "{\"t\": %.1f, \"done\": %d, \"total\": %d, \"per_sec\": %.1f, \"mean_per_sec\": %.1f, \"eta\": %.0f, "
+                  "\"dist_onh_mm\": %.3f, \"failed\": %d, \"fail_rate\": %.5f, \"rss_kb\": %ld%s}\n",
+      t - rep.start, done, rep.total, rate, mean, eta,
+      dist, failed, done > 0 ? (double)failed / done : 0.0, rss_kb(), end ? ", \"end\": 1" : "");
+   fflush(rep.f);
+   rep.lastT    = t;
+   rep.lastDone = done;
+}//record()
+
+/*
+** Thread body: a record every PROGRESS_SECS, or when woken, until told to quit.
+*/
+static gpointer
+reporter(gpointer data) {
+   g_mutex_lock(&rep.lock);
+   while (!rep.quit) {
+      g_cond_wait_until(&rep.wake, &rep.lock, g_get_monotonic_time() + PROGRESS_SECS * G_TIME_SPAN_SECOND);
+      if (!rep.quit)
+         record(0);
+   }
+   g_mutex_unlock(&rep.lock);
+   return NULL;
+}//reporter()
+
+/*
+** Start reporting to file name (nothing if NULL) on total cells to grow.
+** Records are added to the end of the file, or, when resuming a run, after
+** its first length bytes (see checkpoint_reopen()).
+*/
+void
+progress_start(const char *name, int total, long length) {
+   if (name == NULL)
+      return;
+   if ((rep.f = checkpoint_reopen(name, length)) == NULL) {
+      perror(name);               // carry on without
+      return;
+   }
+   progress.done   = 0;
+   progress.failed = 0;
+   progress.last   = 0;
+   rep.quit     = 0;
+   rep.total    = total;
+   rep.start    = rep.lastT = now();
+   rep.lastDone = 0;
+   g_mutex_init(&rep.lock);
+   g_cond_init(&rep.wake);
+   rep.thread = g_thread_new("progress", reporter, NULL);   // aborts if it cannot
+   g_atomic_int_set(&progress.on, 1);
+}//progress_start()
+
+/*
+** Stop the thread, if any, and write the last record.
+*/
+void
+progress_stop() {
+   if (!progress.on)
+      return;
+   g_atomic_int_set(&progress.on, 0);
+   g_mutex_lock(&rep.lock);
+   rep.quit = 1;
+   g_cond_signal(&rep.wake);
+   g_mutex_unlock(&rep.lock);
+   g_thread_join(rep.thread);
+
+   record(1);
+   fclose(rep.f);
+   g_mutex_clear(&rep.lock);
+   g_cond_clear(&rep.wake);
+}//progress_stop()
+
+/*
+** Bytes in the file so far, or -1 if not reporting.
+*/
+long
+progress_length() {
+   if (!progress.on)
+      return -1;
+   g_mutex_lock(&rep.lock);
+   fflush(rep.f);
+   long length = ftell(rep.f);
+   g_mutex_unlock(&rep.lock);
+   return length;
+}//progress_length()
+
+/*
+** Have the thread write a record now.
+*/
+void
+progress_wake() {
+   g_mutex_lock(&rep.lock);
+   g_cond_signal(&rep.wake);
+   g_mutex_unlock(&rep.lock);
+}//progress_wake()
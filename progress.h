@@ -0,0 +1,57 @@
+#ifndef _PROGRESS_H_
+#define _PROGRESS_H_
+
+#include <glib.h>
+
+/*
+** Progress of process(), for watching a long run (stack -t file).
+**
+** grow() only bumps a few counters with progress_cell(); a thread of its own
+** turns them into a record every PROGRESS_SECS seconds, or sooner once
+** PROGRESS_CELLS more cells are done, so the file can be written (and
+** waited on, if it is a pipe) without slowing growth. Each record is one
+** line of JSON with
+**    t              seconds since progress_start()
+**    done, total    cells done (grown, or failed for good) of those to grow
+**    per_sec        cells per second since the last record...
+**    mean_per_sec   ...and since the start
+**    eta            seconds left at per_sec
+**    dist_onh_mm    distance from the ONH edge of the last cell done
+**    failed         cells done that failed (# K and # Kn)...
+**    fail_rate      ...as a fraction of done
+**    rss_kb         resident memory now
+** and a last record (with "end": 1) from progress_stop().
+*/
+
+#define PROGRESS_SECS  30
+#define PROGRESS_CELLS (1 << 20)
+
+typedef struct progress {
+   volatile gint on;       // between progress_start() and progress_stop()
+   volatile gint done;
+   volatile gint failed;
+   volatile gint last;     // cellBlock index of the last cell done
+} Progress;
+
+extern Progress progress;
+
+void progress_start(const char *name, int total, long length);
+void progress_stop();
+long progress_length();
+void progress_wake();
+
+/*
+** cellBlock[i] is done (failed if failed).
+*/
+static inline void
+progress_cell(int i, int failed) {
+   if (!progress.on)
+      return;
+   g_atomic_int_set(&progress.last, i);
+   if (failed)
+      g_atomic_int_inc(&progress.failed);
+   if ((g_atomic_int_add(&progress.done, 1) + 1) % PROGRESS_CELLS == 0)
+      progress_wake();
+}//progress_cell()
+
+#endif
@@ -1,114 +1,143 @@
 #include <glib.h>
 #include <assert.h>
 #include <stdlib.h>
-#include <stdbool.h>
 #include "queue.h"
 
-G_LOCK_DEFINE(queue_lock);
+   // positions are counted in a gint and wrap; compare them as differences
+#define POS_DIFF(_a, _b) ((gint)((guint)(_a) - (guint)(_b)))
 
-static Queue_node *new_node(void);
-
-static Queue_node *new_node(void)
-{
-   Queue_node *n;
-   n = (Queue_node *)malloc(sizeof(Queue_node));
-
-   assert (n != NULL);
-
-   return n;
-}
-
-Queue *new_empty_queue(void)
+/*
+** A queue of at least capacity slots (rounded up to a power of 2).
+*/
+Queue *new_queue(int capacity)
 {
    Queue *q;
    q = (Queue *)malloc(sizeof(Queue));
 
    assert(q != NULL);
+   assert(capacity > 0 && capacity <= (1 << 30));
+
+   guint size = 1;
+   while (size < (guint)capacity)
+      size <<= 1;
 
-   q->head = NULL;
-   q->tail = NULL;
-   q->count = 0;
+   q->slots = (Queue_slot *)malloc(sizeof(Queue_slot) * size);
+   assert(q->slots != NULL);
+   for(guint i = 0 ; i < size ; i++)
+   {
+      q->slots[i].seq  = (gint)i;
+      q->slots[i].cell = NULL;
+   }
+   q->mask = size - 1;
+   q->head = 0;
+   q->tail = 0;
    return q;
 }
 
-void *remove_first(Queue *q)
+Queue *new_empty_queue(void)
 {
-   Queue_node *tmp;
-   void *result;
+   return new_queue(QUEUE_CAPACITY);
+}
 
-   assert(q != NULL);
+void free_queue(Queue *q)
+{
+   free(q->slots);
+   free(q);
+}
 
-   #ifdef ICC
-   #pragma warning (disable:1293) // icc complains about a may_alias attribute, which I think is gcc specific
-   #pragma warning (disable:1292)
-   #endif
-   G_LOCK(queue_lock);
+/*
+** Number of items in q (only a snapshot while others use it).
+*/
+int queue_count(Queue *q)
+{
+   int n = POS_DIFF(g_atomic_int_get(&q->tail), g_atomic_int_get(&q->head));
+   return n < 0 ? 0 : n;
+}
 
-   /* nothing in the queue */
-   if (q->head == NULL)
+/*
+** Claim up to max consecutive slots from position *pos of q: those whose
+** seq is *pos + k + offset (offset 0 to insert, 1 to remove).
+** Returns how many were claimed (with *pos the first), 0 if there are none
+** ready at the end, or -1 if the end moved under us (so try again).
+*/
+static int claim(Queue *q, volatile gint *end, gint *pos, int max, int offset)
+{
+   gint p = g_atomic_int_get(end);
+   int k = 0;
+   while (k < max)
    {
-      assert (q->tail == NULL);
-      result = NULL;
+      Queue_slot *s = q->slots + (((guint)p + k) & q->mask);
+      gint dif = POS_DIFF(g_atomic_int_get(&s->seq), (guint)p + k + offset);
+      if (dif != 0)
+      {
+         if (k == 0 && dif > 0)   // someone else has already used this position
+            return -1;
+         break;
+      }
+      k++;
    }
-   /* one thing in the queue */
-   else if (q->head == q->tail)
+   if (k == 0)
+      return 0;
+   if (!g_atomic_int_compare_and_exchange(end, p, (gint)((guint)p + k)))
+      return -1;
+   *pos = p;
+   return k;
+}
+
+/*
+** Remove up to max items from the front of q into cells, in order.
+** Returns how many, 0 if q is empty.
+*/
+int remove_many(Queue *q, void **cells, int max)
+{
+   assert(q != NULL);
+   gint pos;
+   int k;
+   while ((k = claim(q, &q->head, &pos, max, 1)) < 0)
+      ;
+   for(int j = 0 ; j < k ; j++)
    {
-      q->count--;
-      tmp = q->head;
-      result = tmp->cell;
-      q->head = q->tail = NULL;
-      free(tmp);
+      Queue_slot *s = q->slots + (((guint)pos + j) & q->mask);
+      cells[j] = s->cell;
+      g_atomic_int_set(&s->seq, (gint)((guint)pos + j + q->mask + 1));   // free for the next lap
    }
-   /* more than on thing in the queue */
-   else
+   return k;
+}
+
+/*
+** Add cells[0..n-1] to the end of q, in order (though others' items may
+** come between them), waiting while q is full.
+*/
+void insert_many(Queue *q, void **cells, int n)
+{
+   assert(q != NULL);
+   while (n > 0)
    {
-      q->count--;
-      tmp = q->head;
-      result = tmp->cell;
-      q->head = q->head->next;
-      free(tmp);
+      gint pos;
+      int k = claim(q, &q->tail, &pos, n, 0);
+      if (k == 0)
+         g_thread_yield();   // full
+      for(int j = 0 ; j < k ; j++)
+      {
+         Queue_slot *s = q->slots + (((guint)pos + j) & q->mask);
+         s->cell = cells[j];
+         g_atomic_int_set(&s->seq, (gint)((guint)pos + j + 1));
+      }
+      if (k > 0)
+      {
+         cells += k;
+         n -= k;
+      }
    }
-   #ifdef ICC
-   #pragma warning (disable:1293) // icc complains about a may_alias attribute, which I think is gcc specific
-   #pragma warning (disable:1292)
-   #endif
-   G_UNLOCK(queue_lock);
+}
 
-   return (result);
+void *remove_first(Queue *q)
+{
+   void *cell;
+   return remove_many(q, &cell, 1) == 1 ? cell : NULL;
 }
 
 void insert_last(Queue *q, void *cell)
 {
-   Queue_node *node;
-
-   assert (q != NULL);
-
-   #ifdef ICC
-   #pragma warning (disable:1293) // icc complains about a may_alias attribute, which I think is gcc specific
-   #pragma warning (disable:1292)
-   #endif
-   G_LOCK(queue_lock);
-
-   node = new_node();
-   node->cell = cell;
-   node->next = NULL;
-
-   q->count++;
-   /* nothing in the queue */
-   if (q->head == NULL)
-   {
-      assert (q->tail == NULL);
-      q->head = q->tail = node;
-   }
-   /* at least one thing in the queue */
-   else
-   {
-      q->tail->next = node;
-      q->tail = node;
-   }
-   #ifdef ICC
-   #pragma warning (disable:1293) // icc complains about a may_alias attribute, which I think is gcc specific
-   #pragma warning (disable:1292)
-   #endif
-   G_UNLOCK(queue_lock);
+   insert_many(q, &cell, 1);
 }
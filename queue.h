@@ -3,26 +3,49 @@
 
 #include <glib.h>
 
-G_LOCK_EXTERN(queue_lock);
+/*
+** A bounded multi producer, multi consumer FIFO of pointers, without locks:
+** a ring of slots, each with a sequence number that says whether it is free
+** for the insert at a given position or holds the item for the remove at
+** that position (D. Vyukov's bounded MPMC queue). Producers and consumers
+** claim positions with a compare and swap on tail or head, so nothing is
+** allocated per item.
+**
+** insert_last() waits (yielding) while the queue is full; remove_first()
+** returns NULL if it is empty, so NULL cannot be queued.
+** insert_many() and remove_many() claim as many consecutive slots as they
+** can with one compare and swap.
+*/
 
-typedef struct qnode Queue_node;
+#define QUEUE_CAPACITY 4096   // of new_empty_queue()
+#define QUEUE_PAD      64     // bytes between head and tail, so they are on different cache lines
+
+typedef struct qslot Queue_slot;
 typedef struct queue Queue;
 
-struct qnode
+struct qslot
 {
+   volatile gint seq;   // position this slot is next free for, or that position + 1 once filled
    void *cell;
-   Queue_node *next;
 };
 
 struct queue
 {
-   Queue_node *head;
-   Queue_node *tail;
-   int count;
+   volatile gint tail;  // next position to insert at
+   char pad1[QUEUE_PAD - sizeof(gint)];
+   volatile gint head;  // next position to remove from
+   char pad2[QUEUE_PAD - sizeof(gint)];
+   guint mask;          // capacity - 1
+   Queue_slot *slots;
 };
 
 extern void insert_last(Queue *, void *);
 extern void *remove_first(Queue *);
+extern void insert_many(Queue *, void **, int);
+extern int remove_many(Queue *, void **, int);
+extern int queue_count(Queue *);
 extern Queue *new_empty_queue(void);
+extern Queue *new_queue(int);
+extern void free_queue(Queue *);
 
 #endif
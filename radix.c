@@ -0,0 +1,128 @@
+/*
+** Parallel radix sort of cell locations and of plain keys: see radix.h
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <glib.h>
+#include "types.h"
+#include "radix.h"
+#include "pool.h"
+
+typedef struct radixPart {
+   const void *from;             // PointDs if points, else uint64_t keys
+   void *to;
+   int points;
+   int lo, hi;                   // this thread's part of from[]
+   int shift;                    // of the digit in the key
+   int count[RADIX_BUCKETS];     // of each digit in the part, then where the next goes in to[]
+} RadixPart;
+
+/*
+** A key that orders as cmp_PointD(): the bits of dist, then x, then y, each
+** made to sort as unsigned (and -0 taken as 0).
+*/
+static inline uint64_t
+key(const PointD *p) {
+   float f = p->dist == 0 ? 0 : p->dist;
+   uint32_t d;
+   memcpy(&d, &f, sizeof(d));
+   d = (d & 0x80000000u) ? ~d : (d | 0x80000000u);
+   return ((uint64_t)d << 32) | ((uint32_t)((uint16_t)p->p.x ^ 0x8000) << 16) | ((uint16_t)p->p.y ^ 0x8000);
+}//key()
+
+static inline uint64_t
+key_at(const RadixPart *r, int i) {
+   return r->points ? key((const PointD *)r->from + i) : ((const uint64_t *)r->from)[i];
+}//key_at()
+
+static void
+count_part(void *arg, int t, int worker) {
+   RadixPart *r = (RadixPart *)arg + t;
+   memset(r->count, 0, sizeof(r->count));
+   for(int i = r->lo ; i < r->hi ; i++)
+      r->count[(key_at(r, i) >> r->shift) & (RADIX_BUCKETS - 1)]++;
+}//count_part()
+
+static void
+scatter_part(void *arg, int t, int worker) {
+   RadixPart *r = (RadixPart *)arg + t;
+   for(int i = r->lo ; i < r->hi ; i++) {
+      int j = r->count[(key_at(r, i) >> r->shift) & (RADIX_BUCKETS - 1)]++;
+      if (r->points)
+         ((PointD *)r->to)[j] = ((const PointD *)r->from)[i];
+      else
+         ((uint64_t *)r->to)[j] = ((const uint64_t *)r->from)[i];
+   }
+}//scatter_part()
+
+/*
+** Sort a[0..n-1] (of PointDs if points, else of uint64_ts, each width bytes),
+** split between the workers of the pool (see pool.h) if parallel, else in
+** this thread. Each pass counts digits per part, works out where each part's
+** run of each digit starts, then moves the parts; a digit that is the same
+** in every key is skipped.
+*/
+static void
+radix_sort(void *a, int n, size_t width, int points, int parallel) {
+   if (n < 2)
+      return;
+   int nParts = parallel ? MIN(pool_workers(), 1 + n / 4096) : 1;  // not worth a part for less
+
+   void *buf = malloc(width * n);
+   RadixPart *parts = (RadixPart *)malloc(sizeof(RadixPart) * nParts);
+   assert(buf != NULL && parts != NULL);
+   for(int t = 0 ; t < nParts ; t++) {
+      parts[t].lo = (int)((int64_t)n *  t      / nParts);
+      parts[t].hi = (int)((int64_t)n * (t + 1) / nParts);
+   }
+
+   void *from = a, *to = buf;
+   for(int shift = 0 ; shift < 64 ; shift += RADIX_BITS) {
+      for(int t = 0 ; t < nParts ; t++) {
+         parts[t].from   = from;
+         parts[t].to     = to;
+         parts[t].points = points;
+         parts[t].shift  = shift;
+      }
+      pool_for(nParts, count_part, parts);
+
+      int start = 0, skip = 0;
+      for(int b = 0 ; b < RADIX_BUCKETS ; b++) {
+         int total = 0;                   // of digit b, over every part
+         for(int t = 0 ; t < nParts ; t++)
+            total += parts[t].count[b];
+         if (total == n)
+            skip = 1;
+         for(int t = 0 ; t < nParts ; t++) {
+            int c = parts[t].count[b];
+            parts[t].count[b] = start;
+            start += c;
+         }
+      }
+      if (skip)
+         continue;
+
+      pool_for(nParts, scatter_part, parts);
+      void *tmp = from;
+      from = to;
+      to   = tmp;
+   }
+   if (from != a)
+      memcpy(a, from, width * n);
+
+   free(parts);
+   free(buf);
+}//radix_sort()
+
+void
+radix_sort_PointD(PointD *a, int n, int parallel) {
+   radix_sort(a, n, sizeof(PointD), 1, parallel);
+}//radix_sort_PointD()
+
+void
+radix_sort_uint64(uint64_t *a, int n, int parallel) {
+   radix_sort(a, n, sizeof(uint64_t), 0, parallel);
+}//radix_sort_uint64()
@@ -0,0 +1,19 @@
+#ifndef _RADIX_H_
+#define _RADIX_H_
+
+#include "types.h"
+
+/*
+** Sort PointDs into the order of cmp_PointD() (dist, then x, then y) with a
+** least significant digit first radix sort on a 64 bit key made from all
+** three, split between the pool's workers if parallel (not from a pool task).
+** radix_sort_uint64() does the same for plain keys.
+*/
+
+#define RADIX_BITS    8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+void radix_sort_PointD(PointD *a, int n, int parallel);
+void radix_sort_uint64(uint64_t *a, int n, int parallel);
+
+#endif
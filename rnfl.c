@@ -0,0 +1,272 @@
+/*
+** Nerve fibre layer thickness raster and OCT circle scans: see rnfl.h
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "setup.h"
+#include "density.h"
+#include "types.h"
+#include "cells.h"
+#include "pool.h"
+#include "rnfl.h"
+
+typedef struct raster {
+   int side, bin;
+   int tilesPerSide;
+   uint32_t *count;        // count[bx * side + by]
+   NodeId *ids;            // ids[s] is the Node in slot s...
+   uint32_t *axons;        // ...and axons[s] the axons through it
+   uint32_t *start;        // lines of tile t are slots line[start[t]..start[t+1]-1]
+   uint32_t *line;
+} Raster;
+
+static uint32_t base[NUM_ARENAS];    // slot of NodeId n is base[arena] + handle - 1
+
+static size_t
+node_slot(NodeId n) {
+   return (size_t)base[(uint64_t)n >> NODE_SHIFT] + (n & NODE_MASK) - 1;
+}//node_slot()
+
+/*
+** Ends of the line of the Node in slot s, in pixels (q = p for a root).
+*/
+static void
+line_ends(const Raster *r, size_t s, Point *p, Point *q) {
+   Node *n = NODE(r->ids[s]);
+   *p = CELL(n->c)->p;
+   *q = n->next == NO_NODE ? *p : CELL(NODE(n->next)->c)->p;
+}//line_ends()
+
+/*
+** Number every Node with a slot, and give each the number of axons through
+** it: one for each grown or start cell whose path starts there, plus those
+** of every Node whose next it is. Nodes are taken leaves first (each once
+** all the Nodes before it are done), so nothing is walked twice.
+** Returns the number of slots.
+*/
+static size_t
+count_axons(Raster *r) {
+   size_t numSlots = 0;
+   for(int a = 0 ; a < NUM_ARENAS ; a++) {
+      base[a] = (uint32_t)numSlots;
+      numSlots += nodeArenas[a]->next - 1;
+   }
+   r->ids   = (NodeId *)malloc(sizeof(NodeId) * (numSlots + 1));
+   r->axons = (uint32_t *)calloc(numSlots + 1, sizeof(uint32_t));
+   uint32_t *before = (uint32_t *)calloc(numSlots + 1, sizeof(uint32_t));   // Nodes not yet done whose next it is
+   uint32_t *ready  = (uint32_t *)malloc(sizeof(uint32_t) * (numSlots + 1));
+   assert(r->ids != NULL && r->axons != NULL && before != NULL && ready != NULL);
+
+   for(int a = 0 ; a < NUM_ARENAS ; a++)
+      for(uint32_t h = 1 ; h < nodeArenas[a]->next ; h++) {
+         NodeId n = (uint32_t)((uint64_t)a << NODE_SHIFT) | h;
+         r->ids[base[a] + h - 1] = n;
+         if (NODE(n)->next != NO_NODE)
+            before[node_slot(NODE(n)->next)]++;
+      }
+   for(int i = 0 ; i < numCells ; i++)
+      if (cellBlock[i].path != NO_NODE && (cellBlock[i].status == CELL_GROWN || cellBlock[i].status == CELL_START))
+         r->axons[node_slot(cellBlock[i].path)]++;
+
+   size_t nReady = 0;
+   for(size_t s = 0 ; s < numSlots ; s++)
+      if (before[s] == 0)
+         ready[nReady++] = s;
+   while (nReady > 0) {
+      size_t s = ready[--nReady];
+      NodeId next = NODE(r->ids[s])->next;
+      if (next == NO_NODE)
+         continue;
+      size_t t = node_slot(next);
+      r->axons[t] += r->axons[s];
+      if (--before[t] == 0)
+         ready[nReady++] = t;
+   }
+
+   free(ready);
+   free(before);
+   return numSlots;
+}//count_axons()
+
+/*
+** Add the axons crossing each circle of radii inwards along the line of
+** slot s to profile[circle][degree].
+*/
+static void
+cross_circles(const Raster *r, size_t s, const double *radii, int nRadii, uint64_t (*profile)[360]) {
+   Point p, q;
+   line_ends(r, s, &p, &q);
+   double px = p.x - ONH_X, py = p.y - ONH_Y;
+   double dx = q.x - p.x,   dy = q.y - p.y;
+   double a = dx * dx + dy * dy;
+   if (a == 0)
+      return;
+   double b = 2 * (px * dx + py * dy);
+   for(int c = 0 ; c < nRadii ; c++) {
+      double rad = radii[c] * PIXELS_PER_MM;
+      double disc = b * b - 4 * a * (px * px + py * py - rad * rad);
+      if (disc < 0)
+         continue;
+      double t = (-b - sqrt(disc)) / (2 * a);   // the first crossing is the inward one
+      if (t < 0 || t >= 1)
+         continue;
+      double theta = atan2(py + t * dy, px + t * dx) * 180.0 / M_PI;
+      int deg = (int)floor(theta < 0 ? theta + 360 : theta);
+      profile[c][deg < 360 ? deg : 0] += r->axons[s];
+   }
+}//cross_circles()
+
+/*
+** Share the lines with axons out to the raster tiles their bounding boxes
+** touch.
+*/
+static void
+share_lines(Raster *r, size_t numSlots) {
+   int nTiles = r->tilesPerSide * r->tilesPerSide;
+   int span = r->bin * RNFL_TILE;             // pixels per tile side
+   r->start = (uint32_t *)calloc(nTiles + 1, sizeof(uint32_t));
+   assert(r->start != NULL);
+
+   for(int pass = 0 ; pass < 2 ; pass++) {
+      for(size_t s = 0 ; s < numSlots ; s++) {
+         if (r->axons[s] == 0)
+            continue;
+         Point p, q;
+         line_ends(r, s, &p, &q);
+         int tx0 = min(p.x, q.x) / span, tx1 = (p.x + q.x - min(p.x, q.x)) / span;
+         int ty0 = min(p.y, q.y) / span, ty1 = (p.y + q.y - min(p.y, q.y)) / span;
+         for(int tx = tx0 ; tx <= tx1 ; tx++)
+            for(int ty = ty0 ; ty <= ty1 ; ty++) {
+               int t = tx * r->tilesPerSide + ty;
+               if (pass == 0)
+                  r->start[t + 1]++;
+               else
+                  r->line[r->start[t]++] = (uint32_t)s;
+            }
+      }
+      if (pass == 0) {
+         for(int t = 0 ; t < nTiles ; t++)
+            r->start[t + 1] += r->start[t];
+         r->line = (uint32_t *)malloc(sizeof(uint32_t) * (r->start[nTiles] + 1));
+         assert(r->line != NULL);
+      } else {
+         for(int t = nTiles ; t > 0 ; t--)   // start[t] went on to start[t+1]
+            r->start[t] = r->start[t - 1];
+         r->start[0] = 0;
+      }
+   }
+}//share_lines()
+
+/*
+** Pool task: draw every line of tile t into the raster squares of tile t.
+** Each line steps from square to square (a step in x or in y at a time,
+** whichever side of the square it leaves by first).
+*/
+static void
+draw_tile(void *arg, int t, int worker) {
+   Raster *r = (Raster *)arg;
+   int bx0 = (t / r->tilesPerSide) * RNFL_TILE, bx1 = min(r->side, bx0 + RNFL_TILE);
+   int by0 = (t % r->tilesPerSide) * RNFL_TILE, by1 = min(r->side, by0 + RNFL_TILE);
+
+   for(uint32_t k = r->start[t] ; k < r->start[t + 1] ; k++) {
+      size_t s = r->line[k];
+      uint32_t axons = r->axons[s];
+      Point p, q;
+      line_ends(r, s, &p, &q);
+      double x0 = (p.x + 0.5) / r->bin, y0 = (p.y + 0.5) / r->bin;
+      double x1 = (q.x + 0.5) / r->bin, y1 = (q.y + 0.5) / r->bin;
+      int bx = (int)x0, by = (int)y0;
+      int ex = (int)x1, ey = (int)y1;
+      if (NODE(r->ids[s])->next == NO_NODE) {     // a root counts its own square
+         if (bx >= bx0 && bx < bx1 && by >= by0 && by < by1)
+            r->count[bx * r->side + by] += axons;
+         continue;
+      }
+
+      double dx = x1 - x0, dy = y1 - y0;
+      int sx = dx > 0 ? 1 : -1;
+      int sy = dy > 0 ? 1 : -1;
+      double stepX = dx != 0 ? fabs(1 / dx) : INFINITY;   // of the line, per square
+      double stepY = dy != 0 ? fabs(1 / dy) : INFINITY;
+      double tx = dx > 0 ? (bx + 1 - x0) / dx : (dx < 0 ? (x0 - bx) / -dx : INFINITY);
+      double ty = dy > 0 ? (by + 1 - y0) / dy : (dy < 0 ? (y0 - by) / -dy : INFINITY);
+      for(int n = abs(ex - bx) + abs(ey - by) ; n > 0 ; n--) {
+         if (bx >= bx0 && bx < bx1 && by >= by0 && by < by1)
+            r->count[bx * r->side + by] += axons;
+         if (by == ey || (bx != ex && tx < ty)) {
+            bx += sx;
+            tx += stepX;
+         } else {
+            by += sy;
+            ty += stepY;
+         }
+      }
+   }
+}//draw_tile()
+
+/*
+** Work out the raster and circle scans of the cells as they are now. Write
+** the raster to file name (if not NULL) and print the scan of each of
+** radii[0..nRadii-1] (in mm) to oct.
+** Returns 0, or -1 (with errno set) if the file could not be written.
+*/
+int
+rnfl_write(const char *name, FILE *oct, const double *radii, int nRadii) {
+   assert(nRadii <= OCT_RADII);
+   Raster r;
+   memset(&r, 0, sizeof(r));
+   r.bin  = (int)fmax(1, round(RNFL_UM * PIXELS_PER_MM / 1000.0));
+   r.side = (SIZE + r.bin - 1) / r.bin;
+   r.tilesPerSide = (r.side + RNFL_TILE - 1) / RNFL_TILE;
+   size_t numSlots = count_axons(&r);
+
+   uint64_t profile[OCT_RADII][360];
+   memset(profile, 0, sizeof(profile));
+   for(size_t s = 0 ; s < numSlots && nRadii > 0 ; s++)
+      if (r.axons[s] > 0)
+         cross_circles(&r, s, radii, nRadii, profile);
+   for(int c = 0 ; c < nRadii ; c++)
+      for(int deg = 0 ; deg < 360 ; deg++)
+         fprintf(oct, "# OCT %.3f %3d %llu\n", radii[c], deg, (unsigned long long)profile[c][deg]);
+
+   int result = 0;
+   if (name != NULL) {
+      r.count = (uint32_t *)calloc((size_t)r.side * r.side, sizeof(uint32_t));
+      assert(r.count != NULL);
+      share_lines(&r, numSlots);
+      pool_for(r.tilesPerSide * r.tilesPerSide, draw_tile, &r);
+
+      RnHeader h;
+      memset(&h, 0, sizeof(h));
+      memcpy(h.magic, RN_MAGIC, sizeof(h.magic));
+      h.version     = RN_VERSION;
+      h.endian      = RN_ENDIAN;
+      h.side        = r.side;
+      h.bin         = r.bin;
+      h.pixelsPerMM = PIXELS_PER_MM;
+      h.onhX        = ONH_X;
+      h.onhY        = ONH_Y;
+
+      result = -1;
+      FILE *f = fopen(name, "wb");
+      if (f != NULL) {
+         setvbuf(f, NULL, _IOFBF, 1 << 20);
+         fwrite(&h, sizeof(h), 1, f);
+         fwrite(r.count, sizeof(uint32_t), (size_t)r.side * r.side, f);
+         result = ferror(f) ? -1 : 0;
+         if (fclose(f) != 0)
+            result = -1;
+      }
+   }
+
+   free(r.count);
+   free(r.start);
+   free(r.line);
+   free(r.ids);
+   free(r.axons);
+   return result;
+}//rnfl_write()
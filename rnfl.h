@@ -0,0 +1,57 @@
+#ifndef _RNFL_H_
+#define _RNFL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+** Nerve fibre layer thickness of a grown retina, worked out in place of
+** replaying every path from the report (stack -r file, --oct mm).
+**
+** The axons are the paths of the grown and start cells. Paths share their
+** tails (see pathfile.h), so each Node is given the number of axons through
+** it once, leaves first, and every Node then stands for that many axons on
+** the straight line from its cell to the next Node's.
+**
+** Raster: the axons through each RNFL_UM square of the retina (a square of
+** bin*bin pixels, at least one pixel). A line counts every square it passes
+** through but the one it ends in, which the next line counts (a root Node,
+** next to the ONH, counts its own). Lines are shared out by RNFL_TILE square
+** tiles of the raster, and the tiles drawn as pool tasks. The file is
+**
+**   RnHeader
+**   uint32  count[side * side]   count[bx * side + by] is the square of
+**                                pixels (bx*bin.., by*bin..)
+**
+** in the byte order of the machine that wrote it (see RN_ENDIAN).
+**
+** OCT circle scan: the axons crossing a circle of radius mm around the ONH
+** centre inwards, in each degree of the circle (anticlockwise from +x, in
+** grid coordinates), printed in the report as
+**   # OCT radius degree axons
+** for each of up to OCT_RADII radii.
+*/
+
+#define RN_MAGIC   "STACKRN1"
+#define RN_VERSION 1
+#define RN_ENDIAN  0x01020304  // reads as 0x04030201 on a machine of the other byte order
+
+#define RNFL_UM    10    // micrometres per side of a raster square
+#define RNFL_TILE  64    // raster squares per side of a drawing task
+#define OCT_RADII  8     // most --oct circles
+
+typedef struct rnHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t endian;
+   int32_t side;           // raster is side*side squares...
+   int32_t bin;            // ...of bin*bin pixels
+   int32_t pixelsPerMM;
+   int32_t onhX;
+   int32_t onhY;
+   int32_t pad;
+} RnHeader;
+
+int rnfl_write(const char *name, FILE *oct, const double *radii, int nRadii);
+
+#endif
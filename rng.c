@@ -0,0 +1,59 @@
+/*
+** Counter based random numbers: see rng.h
+*/
+
+#include <math.h>
+#include "rng.h"
+
+/*
+** Start s on the numbers of counter (a, b, kind), for example a tile's
+** (x, y, RNG_TILE).
+*/
+void
+rng_stream_init(RngStream *s, uint64_t seed, uint32_t a, uint32_t b, uint32_t kind) {
+   s->key[0] = (uint32_t)seed;
+   s->key[1] = (uint32_t)(seed >> 32);
+   s->ctr[0] = a;
+   s->ctr[1] = b;
+   s->ctr[2] = kind;
+   s->ctr[3] = 0;
+   s->left   = 0;
+}//rng_stream_init()
+
+/*
+** Next uniform [0,1) number of s.
+*/
+double
+rng_uniform(RngStream *s) {
+   if (s->left == 0) {
+      philox(s->ctr, s->key, s->out);
+      s->ctr[3]++;
+      s->left = 4;
+   }
+   s->left -= 2;
+   return rng_double(s->out[s->left + 1], s->out[s->left]);
+}//rng_uniform()
+
+/*
+** A Poisson(mu) number from s: by inversion, a part of mu at a time (a sum
+** of Poissons is Poisson) so exp(-mu) cannot underflow.
+*/
+unsigned int
+rng_poisson(RngStream *s, double mu) {
+   unsigned int n = 0;
+   while (mu > 0) {
+      double m = mu < 256 ? mu : 256;
+      mu -= m;
+      double p = exp(-m);
+      double sum = p;
+      double u = rng_uniform(s);
+      unsigned int k = 0;
+      while (u > sum && p > 0) {
+         k++;
+         p *= m / k;
+         sum += p;
+      }
+      n += k;
+   }
+   return n;
+}//rng_poisson()
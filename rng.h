@@ -0,0 +1,76 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+
+#include <stdint.h>
+
+/*
+** Counter based random numbers (Philox4x32-10, Salmon et al., SC'11): the
+** numbers are a function of a key (the SEED parameter) and a counter, so
+** they do not depend on which thread draws them, or in what order.
+**
+** Counters are made from coordinates: rng_pixel() is the number for a pixel,
+** and an RngStream is a sequence of numbers for one tile.
+*/
+
+#define RNG_PIXEL 0        // third counter word of a pixel's number
+#define RNG_TILE  1        // ... and of a tile's RngStream
+#define RNG_BENCH 2        // ... and of bench.c's
+#define RNG_CHECK 3        // ... and of check.c's
+
+typedef struct rngStream {
+   uint32_t key[2];
+   uint32_t ctr[4];        // ctr[3] counts the blocks drawn
+   uint32_t out[4];        // the current block
+   int left;               // words of out not used yet
+} RngStream;
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+/*
+** out = Philox4x32-10 of ctr under key.
+*/
+static inline void
+philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]) {
+   uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+   uint32_t k0 = key[0], k1 = key[1];
+   for(int r = 0 ; r < 10 ; r++) {
+      uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+      uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+      c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+      c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+      c1 = (uint32_t)p1;
+      c3 = (uint32_t)p0;
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+   }
+   out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}//philox()
+
+/*
+** A double in [0,1) from the 53 high bits of hi:lo.
+*/
+static inline double
+rng_double(uint32_t hi, uint32_t lo) {
+   return (double)((((uint64_t)hi << 32) | lo) >> 11) * (1.0 / 9007199254740992.0);
+}//rng_double()
+
+/*
+** The uniform [0,1) number of pixel (x,y).
+*/
+static inline double
+rng_pixel(uint64_t seed, int x, int y) {
+   uint32_t key[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
+   uint32_t ctr[4] = {(uint32_t)x, (uint32_t)y, RNG_PIXEL, 0};
+   uint32_t out[4];
+   philox(ctr, key, out);
+   return rng_double(out[0], out[1]);
+}//rng_pixel()
+
+void rng_stream_init(RngStream *s, uint64_t seed, uint32_t a, uint32_t b, uint32_t kind);
+double rng_uniform(RngStream *s);
+unsigned int rng_poisson(RngStream *s, double mu);
+
+#endif
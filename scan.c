@@ -0,0 +1,309 @@
+/*
+** Precomputed search offsets: scanPoints and the sectored ScanTable.
+*/
+
+#define _POSIX_C_SOURCE 200809L   // for mmap() under -std=c99
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include "types.h"
+#include "setup.h"
+#include "density.h"
+#include "scan.h"
+#include "radix.h"
+#include "pool.h"
+
+PointD *scanPoints; // list of deltaX, deltaY, theta to use for searching grid
+int scanPointLen;   // scanPoints[0..scanPointLen-1] are valid
+const char *scanCacheDir = NULL;  // see init_scanPoints(); none unless stack -s
+
+static void *scanMap;      // the cache file scanPoints is mapped from, or NULL if malloc()ed
+static size_t scanMapLen;
+
+typedef struct rings {
+   int *count;       // points in each ring
+   int *start;       // ring k is scanPoints[start[k] .. start[k]+count[k]-1], or NULL to just count
+} Rings;
+
+/*
+** Visit the offsets of ring k: those (other than (0,0)) whose DIST from
+** (0,0) is at most NEW_PATH_RADIUS_LIMIT and truncates to k, as in the old
+** loop over the whole square. If pts is not NULL they go there, dist = DIST.
+** Returns how many there are.
+*/
+static int
+ring_points(int k, PointD *pts) {
+   Point po = {0,0};
+   int n = 0;
+   for(int x = -k ; x <= k ; x++) {
+         // y from the first with x*x+y*y >= k*k*(1 - 2^-23) (whose float DIST
+         // may round up to k) to the last with x*x+y*y < (k+1)*(k+1)
+      int lo = k*k - ((k*k) >> 20) - 1 - x*x;
+      int hi = (k+1)*(k+1) - 1 - x*x;
+      int yLo = lo <= 0 ? 0 : (int)sqrt((double)lo);
+      while (yLo > 0 && (yLo-1)*(yLo-1) >= lo) yLo--;
+      while (yLo*yLo < lo) yLo++;
+      int yHi = (int)sqrt((double)hi);
+      while (yHi*yHi > hi) yHi--;
+      while ((yHi+1)*(yHi+1) <= hi) yHi++;
+      for(int y = yLo ; y <= yHi ; y++)
+         for(int sign = +1 ; sign >= -1 ; sign -= 2) {
+            if (sign < 0 && y == 0) continue;
+            Point p = {x, sign * y};
+            if (p.x == 0 && p.y == 0) continue;  // exclude (0,0)
+            float dist = DIST(p,po);
+            if (dist > NEW_PATH_RADIUS_LIMIT || (int)dist != k) continue;
+            if (pts != NULL) {
+               pts[n].p = p;
+               pts[n].dist = dist;
+            }
+            n++;
+         }
+   }
+   return n;
+}//ring_points()
+
+/*
+** Pool task: count, or fill, sort and give angles to, ring k.
+*/
+static void
+ring_task(void *arg, int k, int worker) {
+   Rings *r = (Rings *)arg;
+   if (r->start == NULL) {
+      r->count[k] = ring_points(k, NULL);
+      return;
+   }
+   PointD *pts = scanPoints + r->start[k];
+   ring_points(k, pts);
+   radix_sort_PointD(pts, r->count[k], 0);   // as qsort() with cmp_PointD()
+   for(int i = 0 ; i < r->count[k] ; i++)
+      pts[i].dist = atan2(pts[i].p.y, pts[i].p.x);
+}//ring_task()
+
+/*
+** Name of the cache file for the current NEW_PATH_RADIUS_LIMIT, or NULL
+** if there is no scanCacheDir. Free it when done.
+** Radii that agree to 6 digits share a name; the radius in the header
+** tells them apart (see cache_read()).
+*/
+static char *
+cache_name() {
+   if (scanCacheDir == NULL)
+      return NULL;
+   char *name = (char *)malloc(strlen(scanCacheDir) + 64);
+   assert(name != NULL);
+   sprintf(name, "%s/scan-%.6g.cache", scanCacheDir, NEW_PATH_RADIUS_LIMIT);
+   return name;
+}//cache_name()
+
+/*
+** Map scanPoints from cache file name. Returns 0, or -1 if it is missing
+** or was not written by this build for this radius.
+*/
+static int
+cache_read(const char *name) {
+   int fd = open(name, O_RDONLY);
+   if (fd < 0)
+      return -1;
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ScanCacheHeader)) {
+      close(fd);
+      return -1;
+   }
+   void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED)
+      return -1;
+
+   const ScanCacheHeader *h = (const ScanCacheHeader *)map;
+   if (memcmp(h->magic, SCAN_MAGIC, sizeof(h->magic)) != 0
+   ||  h->version != SCAN_VERSION || h->pointSize != (int)sizeof(PointD)
+   ||  h->radius != NEW_PATH_RADIUS_LIMIT || h->len < 0
+   ||  (size_t)st.st_size != sizeof(ScanCacheHeader) + sizeof(PointD) * h->len) {
+      munmap(map, st.st_size);
+      return -1;
+   }
+   scanMap      = map;
+   scanMapLen   = st.st_size;
+   scanPoints   = (PointD *)((char *)map + sizeof(ScanCacheHeader));
+   scanPointLen = h->len;
+   return 0;
+}//cache_read()
+
+/*
+** Save scanPoints to cache file name (by way of name.tmp, so a reader
+** never sees half a file). Failure only costs the next run the time.
+*/
+static void
+cache_write(const char *name) {
+   char *tmp = (char *)malloc(strlen(name) + 5);
+   assert(tmp != NULL);
+   sprintf(tmp, "%s.tmp", name);
+
+   ScanCacheHeader h;
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, SCAN_MAGIC, sizeof(h.magic));
+   h.version   = SCAN_VERSION;
+   h.pointSize = sizeof(PointD);
+   h.radius    = NEW_PATH_RADIUS_LIMIT;
+   h.len       = scanPointLen;
+
+   FILE *f = fopen(tmp, "wb");
+   int ok = f != NULL
+         && fwrite(&h, sizeof(h), 1, f) == 1
+         && fwrite(scanPoints, sizeof(PointD), scanPointLen, f) == (size_t)scanPointLen;
+   if (f != NULL && fclose(f) != 0)
+      ok = 0;
+   if (ok)
+      ok = rename(tmp, name) == 0;
+   if (!ok) {
+      perror(name);
+      remove(tmp);
+   }
+   free(tmp);
+}//cache_write()
+
+/*
+** Initialise scanPoints array
+**    p.x = delta x from 0
+**    p.y = delta y from 0
+**    dist = angle of (x,y) from centre (radians)
+** Elements are sorted by distance from (0,0), ties by x then y (cmp_PointD()).
+**
+** Rather than sort the whole square, the points are made a ring (of
+** DIST truncated to k) at a time, in order of k, and each ring sorted on its
+** own. If there is a scanCacheDir the result is kept there and mapped
+** from there next time.
+**
+** Sets scanPointLen.
+*/
+void
+init_scanPoints() {
+   char *name = cache_name();
+   if (name != NULL && cache_read(name) == 0) {
+      free(name);
+      return;
+   }
+
+   int radius = (int)NEW_PATH_RADIUS_LIMIT;
+   int *count = (int *)malloc(sizeof(int) * (radius + 1));
+   int *start = (int *)malloc(sizeof(int) * (radius + 1));
+   assert(count != NULL && start != NULL);
+   Rings rings = {count, NULL};
+   pool_for(radius + 1, ring_task, &rings);   // outer rings are bigger, so stealing evens them out
+   scanPointLen = 0;
+   for(int k = 0 ; k <= radius ; k++) {
+      start[k] = scanPointLen;
+      scanPointLen += count[k];
+   }
+
+   scanPoints = (PointD *) malloc(sizeof(PointD) * MAX(1, scanPointLen));
+   assert(scanPoints != NULL);
+   rings.start = start;
+   pool_for(radius + 1, ring_task, &rings);
+   free(count);
+   free(start);
+
+   if (name != NULL) {
+      cache_write(name);
+      free(name);
+   }
+}//init_scanPoints()
+
+/*
+** Release scanPoints, however init_scanPoints() got them.
+*/
+void
+scan_points_free() {
+   if (scanMap != NULL)
+      munmap(scanMap, scanMapLen);
+   else
+      free(scanPoints);
+   scanMap    = NULL;
+   scanPoints = NULL;
+}//scan_points_free()
+
+/*
+** Sector of angle theta in [-pi, pi]
+*/
+static int
+sector_of(float theta) {
+   int s = (int)((theta + M_PI) / (2.0 * M_PI) * SCAN_SECTORS);
+   if (s < 0) s = 0;
+   if (s >= SCAN_SECTORS) s = SCAN_SECTORS - 1;
+   return s;
+}//sector_of()
+
+/*
+** Regroup scanPoints[0..len-1] (already sorted by distance, dist = angle)
+** by (band, sector, half) with a counting sort, which keeps scanPoints
+** order within each group.
+*/
+ScanTable *
+scan_table_new(PointD *scanPoints, int len) {
+   ScanTable *t = (ScanTable *)malloc(sizeof(ScanTable));
+   assert(t != NULL);
+
+   int *group = (int *)malloc(sizeof(int) * len);
+   assert(group != NULL);
+
+   Point po = {0,0};
+   t->nBands = len == 0 ? 0 : (int)(DIST(scanPoints[len-1].p, po) / SCAN_BAND) + 1;
+   int nGroups = t->nBands * SCAN_SECTORS * SCAN_HALVES;
+   t->start = (int *)calloc(nGroups + 1, sizeof(int));
+   assert(t->start != NULL);
+
+   for(int s = 0 ; s < SCAN_SECTORS ; s++)
+      for(int h = 0 ; h < SCAN_HALVES ; h++) {
+         t->minAngle[s][h] = +4;
+         t->maxAngle[s][h] = -4;
+      }
+
+   for(int i = 0 ; i < len ; i++) {
+      int band = (int)(DIST(scanPoints[i].p, po) / SCAN_BAND);
+      int sector = sector_of(scanPoints[i].dist);
+      int half = scanPoints[i].p.y < 0 ? SCAN_NEG : (scanPoints[i].p.y == 0 ? SCAN_ZERO : SCAN_POS);
+      group[i] = SCAN_GROUP(band, sector, half);
+      t->start[group[i] + 1]++;
+      if (scanPoints[i].dist < t->minAngle[sector][half]) t->minAngle[sector][half] = scanPoints[i].dist;
+      if (scanPoints[i].dist > t->maxAngle[sector][half]) t->maxAngle[sector][half] = scanPoints[i].dist;
+   }
+   for(int g = 0 ; g < nGroups ; g++)
+      t->start[g + 1] += t->start[g];
+
+   t->pts  = (PointD *)malloc(sizeof(PointD) * len);
+   t->rank = (int *)malloc(sizeof(int) * len);
+   assert(t->pts != NULL && t->rank != NULL);
+   int *next = (int *)malloc(sizeof(int) * nGroups);
+   assert(next != NULL);
+   for(int g = 0 ; g < nGroups ; g++)
+      next[g] = t->start[g];
+   for(int i = 0 ; i < len ; i++) {
+      int k = next[group[i]]++;
+      t->pts[k]  = scanPoints[i];
+      t->rank[k] = i;
+   }
+
+   free(next);
+   free(group);
+   return t;
+}//scan_table_new()
+
+/*
+** Release t (but not the scanPoints it was made from).
+*/
+void
+scan_table_free(ScanTable *t) {
+   free(t->pts);
+   free(t->rank);
+   free(t->start);
+   free(t);
+}//scan_table_free()
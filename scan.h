@@ -0,0 +1,60 @@
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include "types.h"
+
+/*
+** scanPoints: offsets within NEW_PATH_RADIUS_LIMIT of (0,0), sorted by distance.
+**
+** For findNewPath the same offsets are also regrouped into a ScanTable by
+**    band   - SCAN_BAND pixels of radius
+**    sector - SCAN_SECTORS equal slices of angle in [-pi, pi]
+**    half   - SCAN_NEG (dy < 0), SCAN_ZERO (dy == 0), SCAN_POS (dy > 0)
+** keeping scanPoints order within each group, so a search can skip whole
+** groups that fail its angle or raphe test rather than testing every point.
+*/
+
+   // cache of scanPoints for one NEW_PATH_RADIUS_LIMIT: this header, then the points
+#define SCAN_MAGIC   "STACKSP1"
+#define SCAN_VERSION 1
+
+typedef struct scanCacheHeader {
+   char magic[8];
+   int version;
+   int pointSize;    // sizeof(PointD)
+   double radius;    // NEW_PATH_RADIUS_LIMIT
+   int len;          // scanPointLen
+   int unused;
+} ScanCacheHeader;
+
+#define SCAN_BAND    16
+#define SCAN_SECTORS 16
+#define SCAN_HALVES   3
+
+#define SCAN_NEG  0
+#define SCAN_ZERO 1
+#define SCAN_POS  2
+#define SCAN_ALL_HALVES ((1 << SCAN_NEG) | (1 << SCAN_ZERO) | (1 << SCAN_POS))
+
+   // index of the group for (band, sector, half)
+#define SCAN_GROUP(_b, _s, _h) (((_b) * SCAN_SECTORS + (_s)) * SCAN_HALVES + (_h))
+
+typedef struct scanTable {
+   int nBands;
+   PointD *pts;      // scanPoints regrouped, dist = angle as in scanPoints
+   int *rank;        // rank[k] = index of pts[k] in scanPoints
+   int *start;       // group g is pts[start[g] .. start[g+1]-1]
+   float minAngle[SCAN_SECTORS][SCAN_HALVES];   // over all bands; min > max if empty
+   float maxAngle[SCAN_SECTORS][SCAN_HALVES];
+} ScanTable;
+
+extern PointD *scanPoints; // list of deltaX, deltaY, theta to use for searching grid
+extern int scanPointLen;   // scanPoints[0..scanPointLen-1] are valid
+extern const char *scanCacheDir;   // directory of scanPoints caches, or NULL for none
+
+void init_scanPoints();
+void scan_points_free();
+ScanTable *scan_table_new(PointD *scanPoints, int scanPointLen);
+void scan_table_free(ScanTable *t);
+
+#endif
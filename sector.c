@@ -0,0 +1,201 @@
+/*
+** Splitting the retina into wedges around the ONH: see sector.h
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <assert.h>
+#include "setup.h"
+#include "density.h"
+#include "types.h"
+#include "grid.h"
+#include "spatial.h"
+#include "cells.h"
+#include "sector.h"
+
+/*
+** Wedge of (x,y): 0..SECTORS-1 anticlockwise from the ONH -> fovea line.
+*/
+int
+sector_of(int x, int y) {
+   double start = atan2((double)SIZE/2 - (double)ONH_Y, (double)SIZE/2 - (double)ONH_X);
+   double theta = atan2((double)y - (double)ONH_Y, (double)x - (double)ONH_X) - start;
+   if (theta < 0)
+      theta += 2.0 * M_PI;
+   int s = (int)(theta / (2.0 * M_PI) * SECTORS);
+   return s >= SECTORS ? SECTORS - 1 : s;
+}//sector_of()
+
+/*
+** A sector for all of grid that reports to stdout.
+*/
+Sector *
+sector_new(int id, Grid *grid, Spatial *spatial) {
+   Sector *sec = (Sector *)calloc(1, sizeof(Sector));
+   assert(sec != NULL);
+   sec->id      = id;
+   sec->grid    = grid;
+   sec->spatial = spatial;
+   sec->out     = stdout;
+   return sec;
+}//sector_new()
+
+/*
+** Make SECTORS wedges, each with an empty grid and spatial index, and
+** share out the cells of cellOrder (keeping their order).
+** Each wedge reports to a temporary file, copied out by sectors_merge()
+** (or nowhere, if whole->out is NULL).
+*/
+Sector *
+sectors_split(Sector *whole) {
+   Sector *sectors = (Sector *)calloc(SECTORS, sizeof(Sector));
+   assert(sectors != NULL);
+
+   int *of = (int *)malloc(sizeof(int) * numCells);
+   assert(of != NULL);
+   for(int k = 0 ; k < numCells ; k++) {
+      Cell *c = cellBlock + cellOrder[k];
+      of[k] = sector_of(c->p.x, c->p.y);
+      sectors[of[k]].nCells++;
+   }
+
+   for(int s = 0 ; s < SECTORS ; s++) {
+      Sector *sec  = sectors + s;
+      sec->id      = s;
+      sec->grid    = grid_new(whole->grid->size);
+      sec->spatial = spatial_clone(whole->spatial, sec->grid);
+      sec->wedge   = 1;
+      sec->out     = whole->out == NULL ? NULL : tmpfile();
+      sec->cells   = (int *)malloc(sizeof(int) * sec->nCells);
+      sec->failed  = (int *)malloc(sizeof(int) * sec->nCells);
+      assert((sec->out != NULL || whole->out == NULL) && sec->cells != NULL && sec->failed != NULL);
+      sec->nCells  = 0;
+      sec->nFailed = 0;
+   }
+   for(int k = 0 ; k < numCells ; k++) {
+      Sector *sec = sectors + of[k];
+      sec->cells[sec->nCells++] = k;
+   }
+
+   free(of);
+   return sectors;
+}//sectors_split()
+
+/*
+** Put sec's cells in its grid. Thread safe for different sectors.
+*/
+void
+sector_fill(Sector *sec) {
+   for(int j = 0 ; j < sec->nCells ; j++) {
+      int i = cellOrder[sec->cells[j]];
+      grid_set_id(sec->grid, cellBlock[i].p.x, cellBlock[i].p.y, FIRST_CELL_ID + i);
+   }
+}//sector_fill()
+
+static int
+cmp_int(const void *a, const void *b) {
+   return *(const int *)a - *(const int *)b;
+}//cmp_int()
+
+/*
+** Add c (whose id is id) to whole's spatial index if it has a path and room,
+** and is the cell at its pixel.
+*/
+static void
+reindex(Sector *whole, Cell *c, CellId id) {
+   c->slot = -1;
+   if (c->path == NO_NODE || !IS_ROOM(ROOM(id)))
+      return;
+   if (grid_get_id(whole->grid, c->p.x, c->p.y) != id)
+      return;
+   spatial_insert(whole->spatial, c, id);
+}//reindex()
+
+/*
+** After every wedge has grown, fold sectors back into whole, and free them.
+**   - each wedge's report is appended to whole->out, its stats to whole->stats;
+**   - fake cells go into whole->grid (which still holds every real cell);
+**   - cells that failed have the counts of their partial path taken back,
+**     and become whole->cells, ready to grow again;
+**   - whole->spatial is rebuilt from scratch;
+**   - whole's marks carry on above every wedge's.
+*/
+void
+sectors_merge(Sector *sectors, Sector *whole) {
+   int nFailed = 0;
+   for(int s = 0 ; s < SECTORS ; s++) {
+      Sector *sec = sectors + s;
+      if (sec->out != NULL) {
+         rewind(sec->out);
+         char buf[BUFSIZ];
+         size_t n;
+         while ((n = fread(buf, 1, sizeof(buf), sec->out)) > 0)
+            fwrite(buf, 1, n, whole->out);
+         fclose(sec->out);
+      }
+
+      Arena *a = fakeCellArenas[sec->id];
+      for(uint32_t h = 1 ; h < a->next ; h++) {
+         Cell *c = (Cell *)arena_at(a, h);
+         if (grid_get_id(whole->grid, c->p.x, c->p.y) == GRID_EMPTY)
+            grid_set_id(whole->grid, c->p.x, c->p.y, FAKE_CELL_ID(sec->id, h));
+      }
+
+      spatial_free(sec->spatial);
+      grid_free(sec->grid);
+      nFailed += sec->nFailed;
+      stats_add(&whole->stats, &sec->stats);
+      if (sec->mark > whole->mark)
+         whole->mark = sec->mark;
+   }
+   if (whole->out != NULL)
+      fflush(whole->out);
+
+   whole->cells  = (int *)malloc(sizeof(int) * (nFailed + 1));
+   assert(whole->cells != NULL);
+   whole->nCells = 0;
+   for(int s = 0 ; s < SECTORS ; s++) {
+      for(int j = 0 ; j < sectors[s].nFailed ; j++) {
+         Cell *c = cellBlock + cellOrder[sectors[s].failed[j]];
+         for(NodeId n = c->path ; n != NO_NODE ; n = NODE(n)->next)
+            ROOM(NODE(n)->c)->count--;
+         c->path = NO_NODE;
+         whole->cells[whole->nCells++] = sectors[s].failed[j];
+      }
+      free(sectors[s].cells);
+      free(sectors[s].failed);
+   }
+   qsort(whole->cells, whole->nCells, sizeof(int), cmp_int);
+
+   for(int i = 0 ; i < numCells ; i++)
+      reindex(whole, cellBlock + i, FIRST_CELL_ID + i);
+   for(int s = 0 ; s < SECTORS ; s++) {
+      Arena *a = fakeCellArenas[sectors[s].id];
+      for(uint32_t h = 1 ; h < a->next ; h++)
+         reindex(whole, (Cell *)arena_at(a, h), FAKE_CELL_ID(sectors[s].id, h));
+   }
+
+   free(sectors);
+}//sectors_merge()
+
+/*
+** Unmark every cell that sec's paths can visit (its own if it is a wedge,
+** else all) and start its marks again. Rare: see MARK_LIMIT.
+*/
+void
+sector_clear_marks(Sector *sec) {
+   if (sec->wedge)
+      for(int j = 0 ; j < sec->nCells ; j++)
+         roomBlock[cellOrder[sec->cells[j]]].mark = 0;
+   else
+      for(int i = 0 ; i < numCells ; i++)
+         roomBlock[i].mark = 0;
+   for(int a = 0 ; a < NUM_ARENAS ; a++) {
+      if (sec->wedge && a != sec->id)
+         continue;
+      for(uint32_t h = 1 ; h < fakeRoomArenas[a]->next ; h++)
+         ((CellRoom *)arena_at(fakeRoomArenas[a], h))->mark = 0;
+   }
+   sec->mark = sec->pathMark = 0;
+}//sector_clear_marks()
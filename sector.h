@@ -0,0 +1,75 @@
+#ifndef _SECTOR_H_
+#define _SECTOR_H_
+
+#include <stdio.h>
+#include "types.h"
+#include "grid.h"
+#include "spatial.h"
+#include "cells.h"
+#include "stats.h"
+
+/*
+** A part of the retina that grows on its own, with its own grid, spatial
+** index and arenas (id is its index into nodeArenas and fakeCellArenas).
+**
+** Normally there is one sector, the whole retina. With -DSECTORS=n (n > 1)
+** process() splits the cells into n wedges around the ONH, the first starting
+** on the line from the ONH through the fovea (so roughly along the raphe),
+** and grows each wedge on its own thread. A wedge only sees its own cells and
+** only makes fake cells inside itself, so wedges share nothing while growing.
+** sectors_merge() then puts everything back into one grid and spatial index,
+** and the cells that failed inside their wedge are tried again on the whole
+** retina, after giving back the room their failed paths took.
+**
+** makeOnePath() marks the cells it visits (CellRoom.mark) rather than
+** setting and clearing flags. Each path, and each of its segments, takes
+** the sector's next mark, so the cells of the path being made are those
+** marked pathMark or later, and nothing needs clearing afterwards. Only
+** the thread growing a sector gives out its marks, and a cell is only
+** visited by its own sector's paths (the whole retina's starts above
+** every wedge's), so sectors never see each other's marks.
+*/
+
+#define MARK_LIMIT (UINT32_MAX / 2)   // marks are cleared before a path starts above this
+
+typedef struct sector {
+   int id;              // arena index
+   Grid *grid;
+   Spatial *spatial;
+   int wedge;           // 1 if empty pixels must have sector_of() == id
+   FILE *out;           // where growth is reported, or NULL
+   int *cells;          // cellOrder indexes (so in increasing distToOnh)
+   int nCells;
+   int *failed;         // cellOrder indexes of cells that need another try, or NULL to report them
+   int nFailed;
+   uint32_t mark;       // the last mark given out...
+   uint32_t pathMark;   // ...and the first of the path being made
+   Stats stats;         // of growing this sector (see stats.h)
+} Sector;
+
+int sector_of(int x, int y);
+Sector *sector_new(int id, Grid *grid, Spatial *spatial);
+Sector *sectors_split(Sector *whole);
+void sector_fill(Sector *sec);
+void sectors_merge(Sector *sectors, Sector *whole);
+void sector_clear_marks(Sector *sec);
+
+/*
+** Start a new path in sec: no cell is marked as on it.
+*/
+static inline void
+sector_new_path(Sector *sec) {
+   if (sec->mark >= MARK_LIMIT)
+      sector_clear_marks(sec);
+   sec->pathMark = ++sec->mark;
+}//sector_new_path()
+
+/*
+** Start a new segment of the path: no cell is marked as counted in it.
+*/
+static inline void
+sector_new_segment(Sector *sec) {
+   ++sec->mark;
+}//sector_new_segment()
+
+#endif
@@ -1,92 +1,74 @@
 /*
 ** Initialise a few key structures
 **    - grid : list of cells with axons going through [x][y]
-**    - cellBlock:  array of numCells cells
+**    - cellBlock:  array of numCells cells, in Morton order of their pixels
+**    - roomBlock:  their counts and thicknesses, in the same order
+**    - cellOrder:  cellBlock indexes in increasing distToOnh, the order they grow in
 */
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
-#include <gsl/gsl_rng.h>
-#include <time.h>
 #include <glib.h>
 #include "types.h"
 #include "setup.h"
 #include "density.h"
 #include "queue.h"
+#include "grid.h"
+#include "rng.h"
+#include "radix.h"
+#include "pool.h"
 
-Grid **grid;      // grid[x][y] of axons passing through 
+Grid *grid;       // cell at each (x,y), see grid.h
 Cell *cellBlock;  // real cells [0..numCells-1]
-int numCells;     // length of cellBlock
+CellRoom *roomBlock;  // roomBlock[i] is the CellRoom of cellBlock[i]
+int *cellOrder;   // cellBlock[cellOrder[k]] is the k-th closest to the ONH
+int numCells;     // length of cellBlock and cellOrder
 
 typedef struct bb { 
-   int tlx,tly,brx,bry; // bounding box top-left and bottom-right
-   gsl_rng *rng;        // random numbers
-   int *numCells;       // num cells created in this bb
+   int tlx,tly,brx,bry; // bounding box top-left and bottom-right, within one tile
+   int numCells;        // num cells created by this worker
+   int maxCells;        // room in loc
    PointD *loc;         // array of numCells locations of cells
 } BB;  
 
-static gpointer init_grid_piece(gpointer data) {
-   BB *bb = (BB *)data;
-//printf("Init gp: (%d,%d) -> (%d,%d)\n",bb->tlx,bb->tly,bb->brx, bb->bry);
-   for(int x = bb->tlx ; x <= bb->brx ; x++) {
-      for(int y = bb->tly ; y <= bb->bry ; y++) {
-         grid[x][y].soma = NULL;
-      }
-   }
-   return NULL;
-}//init_grid_piece()
-
 /* 
-   Set square grid SIZE*SIZE all to NULL, *** except in fovea, raphe and ONH where set to 1 
+   Create an empty SIZE*SIZE sparse grid (or empty *inGrid if not NULL,
+   or make a new one if *inGrid is another size), then mark fovea, raphe and ONH as GRID_BLOCKED.
+   Tiles are allocated lazily, so only the blocked areas cost memory here.
    Assumes fovea is at (SIZE/2, SIZE/2)
    Assumes raphe is at (0...SIZE/2, SIZE/2)
    Sets *size to SIZE
 */
-void init_grid(int *size, Grid ***inGrid) 
+void init_grid(int *size, Grid **inGrid) 
 {
    *size = SIZE;
 
-   grid = (Grid **) malloc(sizeof(Grid *)*SIZE);
-   assert(grid != NULL);
-   for(int x = 0 ; x < SIZE ; x++) {
-      grid[x] = (Grid *) malloc(sizeof(Grid)*SIZE);
-      assert(grid[x] != NULL);
-   }
-
    fprintf(stderr,"Initialising grid\n");
 
-        //Create threads into an array threads[0..THREADS-1]
-   BB *bb = (BB *)malloc(sizeof(BB) * (THREADS+1));
-   for(int i = 0 ; i < THREADS+1 ; i++) {
-      bb[i].tlx = (int)round((float)    i   * (float)SIZE / ((float)THREADS+1.0))    ;
-      bb[i].brx = (int)round(((float)i+1.0) * (float)SIZE / ((float)THREADS+1.0)) - 1;
-      bb[i].tly = 0;
-      bb[i].bry = SIZE - 1;
-      bb[i].rng = NULL; 
+   if (*inGrid != NULL && (*inGrid)->size != SIZE) {   // PIXELS_PER_MM changed
+      grid_free(*inGrid);
+      *inGrid = NULL;
+   }
+   if (*inGrid == NULL)
+      grid = grid_new(SIZE);
+   else {
+      grid = *inGrid;
+      grid_clear(grid);
    }
-   GError    *error = NULL;
-   GThread **threads = (GThread **)malloc(sizeof(GThread *) * (THREADS));
-   for(int i = 0 ; i < THREADS ; i++)
-      threads[i] = g_thread_create( init_grid_piece, (gpointer)(bb + i) , TRUE, &error );
-   init_grid_piece((gpointer) (bb + THREADS));
-
-   for(int i = 0 ; i < THREADS ; i++)
-      g_thread_join(threads[i]);
-   free(bb);
-   free(threads);
 
       // block out fovea
    for(int x = -FOVEA_RADIUS ; x <= +FOVEA_RADIUS ; x++)
       for(int y = -FOVEA_RADIUS ; y <= +FOVEA_RADIUS ; y++)
          if (x*x + y*y <= FOVEA_RADIUS * FOVEA_RADIUS)
-            grid[SIZE/2+x][SIZE/2+y].soma = (Cell *)1;
+            grid_set_id(grid, SIZE/2+x, SIZE/2+y, GRID_BLOCKED);
 
       // add horizontal raphe
    for(int x = 0 ; x < SIZE/2 ; x++) {
       int y = SIZE/2;      // XXX might want to change this to be dependant on Fov->ONH angle
-      grid[x][y].soma = (Cell *)1;
+      grid_set_id(grid, x, y, GRID_BLOCKED);
    }
 
       // block out ONH (+-2 in loops to catch rounding errors)
@@ -96,48 +78,170 @@ void init_grid(int *size, Grid ***inGrid)
          Point p = {x,y};
          Point po = {ONH_X, ONH_Y};
          if (DIST(p,po) <= ONH_EDGE(theta) + 1)  // +1 just to get at least one pixel away
-            grid[x][y].soma = (Cell *)1;
+            grid_set_id(grid, x, y, GRID_BLOCKED);
       }
 
    *inGrid = grid;
+}//init_grid()
 
 /*
-   for(int x = 0 ; x < SIZE ; x++)
-      for(int y = 0 ; y < SIZE ; y++)
-         if (grid[x][y] > 0)
-            printf("%d %d %d\n",x,y,grid[x][y]);
+** Put a cell at (x,y) in bb->loc, making it bigger if need be.
 */
+static void add_cell(BB *bb, int x, int y) {
+//printf("\t(%d,%d) %d\n",bb->tlx,bb->tly,bb->numCells);fflush(stdout);
+   if (bb->numCells == bb->maxCells) {
+      bb->maxCells = bb->maxCells == 0 ? 4096 : 2 * bb->maxCells;
+      bb->loc = (PointD *)realloc(bb->loc, sizeof(PointD) * bb->maxCells);
+      assert(bb->loc != NULL);
+   }
+   double theta = atan2((double) y - (double)ONH_Y, (double) x - (double)ONH_X);
+   Point p = {x,y};
+   Point po = {ONH_X, ONH_Y};
+   bb->loc[bb->numCells].p = p;
+   bb->loc[bb->numCells].dist = DIST(p,po) - ONH_EDGE(theta);
+   bb->numCells += 1;
+}//add_cell()
 
-}//init_grid()
-
-// *** Note reset soma to NULL if soma == 1
-static gpointer make_cell_piece(gpointer data) {
-   BB *bb = (BB *)data;
+// *** Note grid is only read here; blocked pixels are cleared afterwards by grid_clear_blocked()
+static void make_cell_piece(BB *bb) {
 //printf("make Cell gp: (%d,%d) -> (%d,%d)\n",bb->tlx,bb->tly,bb->brx, bb->bry);fflush(stdout);
+   int n = bb->bry - bb->tly + 1;
+   double ys[TILE_SIZE], d[TILE_SIZE], err[TILE_SIZE];
+   assert(n <= TILE_SIZE);
+   for(int y = bb->tly ; y <= bb->bry ; y++)
+      ys[y - bb->tly] = ((float)y-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+
+   double scale = 1.0 / (double)PIXELS_PER_MM / (double)PIXELS_PER_MM*DENSE_SCALE;
    for(int x = bb->tlx ; x <= bb->brx ; x++) {
+      double mx = ((float)x-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+      density_row(mx, ys, n, d, err);
       for(int y = bb->tly ; y <= bb->bry ; y++) {
             // check room, not in fovea, not in ONH, not on raphe
-         if (grid[x][y].soma) {
-            grid[x][y].soma = NULL;      // reset soma
+         if (grid_get_id(grid, x, y) == GRID_BLOCKED)
             continue;
-         }
             // flip coin...
-         double prob = find_density(((float)x-(float)SIZE/2.0)/(float)PIXELS_PER_MM, ((float)y-(float)SIZE/2.0)/(float)PIXELS_PER_MM) / (double)PIXELS_PER_MM / (double)PIXELS_PER_MM*DENSE_SCALE;
-         if (gsl_rng_uniform(bb->rng) < prob) {
-//printf("\t(%d,%d) %d\n",bb->tlx,bb->tly,*(bb->numCells));fflush(stdout);
-            double theta = atan2((double) y - (double)ONH_Y, (double) x - (double)ONH_X);
-            Point p = {x,y};
-            Point po = {ONH_X, ONH_Y};
-            bb->loc[*(bb->numCells)].p = p;
-            bb->loc[*(bb->numCells)].dist = DIST(p,po) - ONH_EDGE(theta);
-            *(bb->numCells) += 1;
-         }
+            // only near the edge of prob does the exact density matter
+         double u = rng_pixel(SEED, x, y);
+         double prob  = d[y - bb->tly] * scale;
+         double slack = err[y - bb->tly] * scale;
+         int in = u < prob - slack;
+         if (!in && u < prob + slack)
+            in = u < find_density(mx, ys[y - bb->tly]) / (double)PIXELS_PER_MM / (double)PIXELS_PER_MM*DENSE_SCALE;
+         if (in)
+            add_cell(bb, x, y);
       }
    }
-   return NULL;
 }//make_cell_piece()
 
-// sort by increasing dist
+/*
+** Same as make_cell_piece() (each pixel not blocked is a cell with
+** probability prob, independently) in time proportional to the number of
+** cells rather than pixels.
+**
+** For each TILE_SIZE*TILE_SIZE tile, take rate(p) = -log(1-prob(p)) so that a
+** Poisson number of points with mean rate(p) lands on pixel p at least once
+** with probability prob(p). Points at the tile's top rate, rateMax (from
+** density_max()), are a Poisson(rateMax * pixels) count placed uniformly in
+** the tile; keeping each with probability rate(p)/rateMax thins them to
+** rate(p) at every pixel. A pixel that keeps one or more points is a cell.
+*/
+static void make_cell_piece_poisson(BB *bb) {
+   double scale = 1.0 / (double)PIXELS_PER_MM / (double)PIXELS_PER_MM*DENSE_SCALE;
+   uint64_t taken[TILE_SIZE];   // bit ly of taken[lx] set if the tile's (lx,ly) is a cell
+
+   for(int x0 = bb->tlx ; x0 <= bb->brx ; x0 += TILE_SIZE - (x0 & TILE_MASK))
+      for(int y0 = bb->tly ; y0 <= bb->bry ; y0 += TILE_SIZE - (y0 & TILE_MASK)) {
+         int x1 = MIN(bb->brx, x0 | TILE_MASK);
+         int y1 = MIN(bb->bry, y0 | TILE_MASK);
+         int w = x1 - x0 + 1;
+         int h = y1 - y0 + 1;
+
+            // eccentricity range of the tile, in mm
+         double mx0 = ((float)x0-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+         double mx1 = ((float)x1-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+         double my0 = ((float)y0-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+         double my1 = ((float)y1-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+         double nx = mx0 > 0 ? mx0 : (mx1 < 0 ? mx1 : 0);
+         double ny = my0 > 0 ? my0 : (my1 < 0 ? my1 : 0);
+         double fx = MAX(fabs(mx0), fabs(mx1));
+         double fy = MAX(fabs(my0), fabs(my1));
+         double probMax = density_max(sqrt(nx*nx + ny*ny), sqrt(fx*fx + fy*fy)) * scale;
+         if (probMax <= 0)
+            continue;
+
+         if (probMax >= 1) {   // no finite rate: a trial per pixel, as make_cell_piece()
+            for(int x = x0 ; x <= x1 ; x++)
+               for(int y = y0 ; y <= y1 ; y++) {
+                  if (grid_get_id(grid, x, y) == GRID_BLOCKED)
+                     continue;
+                  double mx = ((float)x-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+                  double my = ((float)y-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+                  if (rng_pixel(SEED, x, y) < find_density(mx, my) * scale)
+                     add_cell(bb, x, y);
+               }
+            continue;
+         }
+
+         double rateMax = -log1p(-probMax);
+         RngStream rng;
+         rng_stream_init(&rng, SEED, x0 >> TILE_BITS, y0 >> TILE_BITS, RNG_TILE);
+         unsigned int n = rng_poisson(&rng, rateMax * w * h);
+         memset(taken, 0, sizeof(taken));
+         for(unsigned int k = 0 ; k < n ; k++) {
+            int x = x0 + MIN(w - 1, (int)(rng_uniform(&rng) * w));
+            int y = y0 + MIN(h - 1, (int)(rng_uniform(&rng) * h));
+            double u = rng_uniform(&rng);
+            if (TILE_BIT(taken, x, y) || grid_get_id(grid, x, y) == GRID_BLOCKED)
+               continue;
+            double mx = ((float)x-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+            double my = ((float)y-(float)SIZE/2.0)/(float)PIXELS_PER_MM;
+            double prob = find_density(mx, my) * scale;
+            if (u * rateMax < -log1p(-prob)) {
+               taken[x & TILE_MASK] |= (uint64_t)1 << (y & TILE_MASK);
+               add_cell(bb, x, y);
+            }
+         }
+      }
+}//make_cell_piece_poisson()
+
+/*
+** Pool task: make the cells of tile t (tiles numbered down each column)
+** into worker's BB.
+*/
+static void make_cells_tile(void *arg, int t, int worker) {
+   BB *bb = (BB *)arg + worker;
+   int tiles = (SIZE + TILE_MASK) >> TILE_BITS;
+   bb->tlx = (t / tiles) * TILE_SIZE;
+   bb->tly = (t % tiles) * TILE_SIZE;
+   bb->brx = MIN(SIZE, bb->tlx + TILE_SIZE) - 1;
+   bb->bry = MIN(SIZE, bb->tly + TILE_SIZE) - 1;
+   if (POISSON_CELLS)
+      make_cell_piece_poisson(bb);
+   else
+      make_cell_piece(bb);
+}//make_cells_tile()
+
+/*
+** Set cellBlock[i] (whose p is set) ungrown and put it in the grid.
+*/
+static void init_cell(int i)
+{
+   Cell *c = cellBlock + i;
+   CellRoom *r = roomBlock + i;
+   c->path      = NO_NODE;
+   r->count     = 0;
+   r->mark      = 0;
+   r->pad       = 0;
+   c->status    = CELL_UNGROWN;
+   int distFromFovea = MACULAR_DIST_SQ(c->p);
+   r->thickness = MAX_AXON_COUNT(sqrt(distFromFovea));
+   c->alternate = NO_CELL;
+   c->slot      = -1;
+
+   grid_set_id(grid, c->p.x, c->p.y, FIRST_CELL_ID + i);
+}//init_cell()
+
+// sort by increasing dist, then x and y so the order does not depend on the threads
 int cmp_PointD(const void *a, const void *b)
 {
    PointD *aa = (PointD *)a;
@@ -146,72 +250,105 @@ int cmp_PointD(const void *a, const void *b)
       return -1;
    if (aa->dist > bb->dist)
       return +1;
+   if (aa->p.x != bb->p.x)
+      return aa->p.x < bb->p.x ? -1 : +1;
+   if (aa->p.y != bb->p.y)
+      return aa->p.y < bb->p.y ? -1 : +1;
    return 0;
 }
 
 /*
-** Allocate all cell memory, initialise cells, link them to grid[][].soma
-**  - all cells are in outCellBlock[0..numCells-1]
-**    sorted by increasing distToOnh
+** Bits of v (< 2^16) spread out to the even bits of the result.
+*/
+static inline uint32_t spread_bits(uint32_t v) {
+   v = (v | (v << 8)) & 0x00ff00ffu;
+   v = (v | (v << 4)) & 0x0f0f0f0fu;
+   v = (v | (v << 2)) & 0x33333333u;
+   v = (v | (v << 1)) & 0x55555555u;
+   return v;
+}//spread_bits()
+
+/*
+** Morton (Z order) key of p: the bits of x and y interleaved, x above y, so
+** each aligned power of two square (a grid tile, say) is one run of keys.
+*/
+static inline uint32_t morton(Point p) {
+   return spread_bits((uint16_t)p.x) << 1 | spread_bits((uint16_t)p.y);
+}//morton()
+
+/*
+** Allocate all cell memory, initialise cells, link them to the grid
+**  - all cells are in cellBlock[0..numCells-1] in Morton order of their
+**    pixels, so cells close on the retina (as the searches of growth
+**    visit them) are close in memory
+**  - cellOrder[0..numCells-1] holds their indexes sorted by increasing
+**    distToOnh, the order process() grows them in
 */
 void init_cells()
 {
    fprintf(stderr,"\nMaking cells\n");
-        //Create threads into an array threads[0..THREADS-1]
-   BB *bb = (BB *)malloc(sizeof(BB) * (THREADS+1));
-   for(int i = 0 ; i < THREADS+1 ; i++) {
-      bb[i].tlx = (int)round((float)    i   * (float)SIZE / ((float)THREADS+1.0))    ;
-      bb[i].brx = (int)round(((float)i+1.0) * (float)SIZE / ((float)THREADS+1.0)) - 1;
-      bb[i].tly = 0;
-      bb[i].bry = SIZE - 1;
-
-      bb[i].rng = gsl_rng_alloc(gsl_rng_default);
-      gsl_rng_set(bb[i].rng, time(NULL) * (i+1));
-      //gsl_rng_set(bb[i].rng, 1 * (i+1));
-
-      bb[i].numCells = (int *)malloc(sizeof(int));
-      *(bb[i].numCells) = 0;
-      bb[i].loc      = (PointD *)malloc(sizeof(PointD)*(bb[i].brx-bb[i].tlx+1)*(bb[i].bry-bb[i].tly+1));
-   }
-   GError    *error = NULL;
-   GThread **threads = (GThread **)malloc(sizeof(GThread *) * (THREADS));
-   for(int i = 0 ; i < THREADS ; i++)
-      threads[i] = g_thread_create( make_cell_piece, (gpointer)(bb + i) , TRUE, &error );
-   make_cell_piece((gpointer) (bb + THREADS));
+   density_init(sqrt(2.0) * SIZE / 2.0 / PIXELS_PER_MM + 1);
+        // a task per tile, so the busy tiles near the fovea are shared out
+        // (the random numbers do not depend on which worker makes a tile)
+   int nWorkers = pool_workers();
+   int tiles = (SIZE + TILE_MASK) >> TILE_BITS;
+   BB *bb = (BB *)calloc(nWorkers, sizeof(BB));
+   assert(bb != NULL);
+   pool_for(tiles * tiles, make_cells_tile, bb);
 
       // for each pixel, set with prob = #rgs-in-this-square/PIXELS_PER_MM^2
-   PointD *loc = (PointD *)malloc(sizeof(PointD) * SIZE * SIZE);  // a temporary list of locations
    numCells = 0;
-   for(int i = 0 ; i < THREADS+1 ; i++) {
-      if (i < THREADS)
-         g_thread_join(threads[i]);
+   for(int i = 0 ; i < nWorkers ; i++)
+      numCells += bb[i].numCells;
 
-      for(int j = numCells ; j < numCells + *(bb[i].numCells) ; j++)
-         loc[j] = bb[i].loc[j - numCells];
-
-      numCells += *(bb[i].numCells);
-
-      free(bb[i].numCells);
+   PointD *loc = (PointD *)malloc(sizeof(PointD) * numCells);  // a temporary list of locations
+   assert(loc != NULL);
+   for(int i = 0, j = 0 ; i < nWorkers ; j += bb[i].numCells, i++) {
+      memcpy(loc + j, bb[i].loc, sizeof(PointD) * bb[i].numCells);
       free(bb[i].loc);
    }
+   free(bb);
 
    fprintf(stderr,"# Number of cells = %d\n",numCells);
 
-   qsort(loc, numCells, sizeof(PointD), cmp_PointD);
+   grid_clear_blocked(grid);
 
+   radix_sort_PointD(loc, numCells, 1);   // as qsort() with cmp_PointD()
+
+      // Morton key above place in loc, sorted, gives each cell's place in cellBlock
+   uint64_t *z = (uint64_t *)malloc(sizeof(uint64_t) * numCells);
+   assert(z != NULL);
+   for (int k = 0 ; k < numCells ; k++)
+      z[k] = (uint64_t)morton(loc[k].p) << 32 | (uint32_t)k;
+   radix_sort_uint64(z, numCells, 1);
+
+   free(cellBlock);
+   free(roomBlock);
+   free(cellOrder);
    cellBlock = (Cell *)malloc(sizeof(Cell) * numCells);
-   assert(cellBlock != NULL);
+   roomBlock = (CellRoom *)malloc(sizeof(CellRoom) * numCells);
+   cellOrder = (int *)malloc(sizeof(int) * numCells);
+   assert(cellBlock != NULL && roomBlock != NULL && cellOrder != NULL);
    for (int i = 0 ; i < numCells ; i++) {
-      cellBlock[i].p         = loc[i].p;
-      cellBlock[i].path      = NULL;
-      //cellBlock[i].distToOnh = loc[i].dist;
-      cellBlock[i].count     = 0;
-      cellBlock[i].flag      = 0;
-      int distFromFovea = MACULAR_DIST_SQ(loc[i].p);
-      cellBlock[i].thickness = MAX_AXON_COUNT(sqrt(distFromFovea));
-      cellBlock[i].alternate = NULL;
-   
-      grid[loc[i].p.x][loc[i].p.y].soma = cellBlock + i;
+      int k = (int)(uint32_t)z[i];
+      cellOrder[k] = i;
+      cellBlock[i].p = loc[k].p;
+      //cellBlock[i].distToOnh = loc[k].dist;
+      init_cell(i);
    }
+   free(z);
+   free(loc);
    return;
 }//init_cells()
+
+/*
+** Put the cells made by init_cells() back as they were, ungrown, in an
+** emptied grid, for another run whose parameters do not move them
+** (see params_same_cells()). Thicknesses follow the current params.
+*/
+void reset_cells()
+{
+   grid_clear(grid);
+   for (int i = 0 ; i < numCells ; i++)
+      init_cell(i);
+}//reset_cells()
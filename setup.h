@@ -1,20 +1,27 @@
 #include "types.h"
 #include "queue.h"
+#include "params.h"
 
-#define PIXELS_PER_MM 1000
+#define FULL_PIXELS_PER_MM 1000  // the resolution of a production run
+#define MAX_PIXELS_PER_MM  1638  // so SIZE fits in a Point's short coordinates
 
-#define DENSE_SCALE 1.2 // multiply density by this factor
+   // these are set at run time: see params.h
+#define PIXELS_PER_MM (params.pixelsPerMM)
+#define DENSE_SCALE (params.denseScale) // multiply density by this factor
+#define SEED ((uint64_t)params.seed)   // of the cells' random numbers, see rng.h
+#define POISSON_CELLS (params.poissonCells) // place cells a tile at a time, see make_cell_piece_poisson()
 
-#define SIZE (20 * PIXELS_PER_MM) //  20 mm square
+#define SIZE_MM 20
+#define SIZE (SIZE_MM * PIXELS_PER_MM) //  20 mm square
 
-#define AXIAL_LENGTH 25    // mm
+#define AXIAL_LENGTH (params.axialLength)    // mm
 
 #define FOVEA_RADIUS ( 0.2 * PIXELS_PER_MM)
 
-#define ONH_X (int)((SIZE/2 + (15.0   /180.0*M_PI*AXIAL_LENGTH/2.0*PIXELS_PER_MM)))   // degrees -> pixels
-#define ONH_Y (int)((SIZE/2 + ( 2.0   /180.0*M_PI*AXIAL_LENGTH/2.0*PIXELS_PER_MM)))   // degrees -> pixels
-#define ONH_MAJOR (int)(1.66/2.0 * (double)PIXELS_PER_MM) /* 1.66mm 2*major axis (x) of optic nerve */
-#define ONH_MINOR (int)(1.94/2.0 * (double)PIXELS_PER_MM) /* 1.94mm 2*minor axis (y) of optic nerve */
+#define ONH_X (params.onhX)            // pixels
+#define ONH_Y (params.onhY)            // pixels
+#define ONH_MAJOR (params.onhMajor)    /* 2*major axis (x) of optic nerve */
+#define ONH_MINOR (params.onhMinor)    /* 2*minor axis (y) of optic nerve */
 
 #define DIST(_p1, _p2)  (float)sqrt( ((double)(_p1).x-(double)(_p2).x)*((double)(_p1).x-(double)(_p2).x) + ((double)(_p1).y-(double)(_p2).y)*((double)(_p1).y-(double)(_p2).y) )
 
@@ -25,7 +32,7 @@
 #define START_DIST 0.2*PIXELS_PER_MM    // number of pixels from ONH_EDGE to be included in first pool
 
    // macros to control thickness
-#define MACULAR_RADIUS (3 * PIXELS_PER_MM)
+#define MACULAR_RADIUS (params.macularRadius)
 #define MACULAR_RADIUS_SQ (MACULAR_RADIUS * MACULAR_RADIUS)
 #define MACULAR_DIST(_p) (int)round(sqrt( ((_p).x-SIZE/2)*((_p).x-SIZE/2)+((_p).y-SIZE/2)*((_p).y-SIZE/2)))
 #define MACULAR_DIST_SQ(_p) ( ((_p).x - SIZE/2)*((_p).x - SIZE/2) + ((_p).y - SIZE/2)*((_p).y - SIZE/2))
@@ -34,16 +41,17 @@
 #define min(_a, _b) ((_a) < (_b) ? (_a) : (_b))
 //#define MAX_THICK 20
 //#define MAX_AXON_COUNT(_dist) (int)round(((float)(_dist)-(float)FOVEA_RADIUS)/(float)MACULAR_RADIUS * (float)MAX_THICK*(float)DENSE_SCALE)
-#define MAX_THICK 60
+#define MAX_THICK (params.maxThick)
 #define MAX_AXON_COUNT(_dist) min(MAX_THICK, (int)round(((float)(_dist)-(float)FOVEA_RADIUS)/(float)MACULAR_RADIUS * (float)MAX_THICK))
 
     // how far to search for a new path during growth?
-#define NEW_PATH_RADIUS_LIMIT (MACULAR_RADIUS/2.0*1.1)
+#define NEW_PATH_RADIUS_LIMIT (params.newPathRadiusLimit)
 
     // don't search outside +- this from proposed trajectory during growth
-#define THETA_LIMIT  M_PI // (M_PI/3.0)     
+#define THETA_LIMIT  (params.thetaLimit)
 
    // all in pixels
-void init_grid(int *size, Grid ***grid);
+void init_grid(int *size, Grid **grid);
 void init_cells();
+void reset_cells();
 int cmp_PointD(const void *a, const void *b);
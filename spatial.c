@@ -0,0 +1,211 @@
+/*
+** Bucketed uniform grid of cells that have a path and room for another.
+**
+** spatial_nearest() returns exactly the cell that a linear walk along
+** scanPoints would have found: candidates are ranked by their position in
+** scanPoints, and buckets are visited in rings of increasing distance until
+** no unvisited bucket can hold anything closer than the best so far.
+*/
+
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+#include "types.h"
+#include "grid.h"
+#include "main.h"
+#include "spatial.h"
+
+/*
+** Create an empty index for cells in grid.
+** Offsets are ranked by their position in scanPoints[0..scanPointLen-1],
+** all of which must lie within radius of (0,0).
+*/
+Spatial *
+spatial_new(Grid *grid, PointD *scanPoints, int scanPointLen, int radius) {
+   Spatial *s = (Spatial *)malloc(sizeof(Spatial));
+   assert(s != NULL);
+
+   s->grid = grid;
+   s->bucketsPerSide = (grid->size + SPATIAL_BUCKET - 1) / SPATIAL_BUCKET;
+   s->buckets = (Bucket *)calloc((size_t)s->bucketsPerSide * s->bucketsPerSide, sizeof(Bucket));
+   assert(s->buckets != NULL);
+
+   s->radius = radius;
+   int w = 2 * radius + 1;
+   s->rank = (int *)malloc(sizeof(int) * w * w);
+   assert(s->rank != NULL);
+   for(int i = 0 ; i < w * w ; i++)
+      s->rank[i] = -1;
+   for(int i = 0 ; i < scanPointLen ; i++)
+      s->rank[(scanPoints[i].p.x + radius) * w + scanPoints[i].p.y + radius] = i;
+   s->ownsRank = 1;
+
+   return s;
+}//spatial_new()
+
+/*
+** Create an empty index for cells in grid, sharing the rank table
+** (which must outlive it) of proto.
+*/
+Spatial *
+spatial_clone(const Spatial *proto, Grid *grid) {
+   Spatial *s = (Spatial *)malloc(sizeof(Spatial));
+   assert(s != NULL);
+
+   s->grid = grid;
+   s->bucketsPerSide = proto->bucketsPerSide;
+   s->buckets = (Bucket *)calloc((size_t)s->bucketsPerSide * s->bucketsPerSide, sizeof(Bucket));
+   assert(s->buckets != NULL);
+   s->radius   = proto->radius;
+   s->rank     = proto->rank;
+   s->ownsRank = 0;
+
+   return s;
+}//spatial_clone()
+
+/*
+** Release s. The cells' slots are left as they are.
+*/
+void
+spatial_free(Spatial *s) {
+   for(int i = 0 ; i < s->bucketsPerSide * s->bucketsPerSide ; i++)
+      free(s->buckets[i].e);
+   free(s->buckets);
+   if (s->ownsRank)
+      free(s->rank);
+   free(s);
+}//spatial_free()
+
+/*
+** Empty s, keeping its memory for reuse. The cells' slots are left as they are.
+*/
+void
+spatial_clear(Spatial *s) {
+   for(int i = 0 ; i < s->bucketsPerSide * s->bucketsPerSide ; i++)
+      s->buckets[i].len = 0;
+}//spatial_clear()
+
+/*
+** Index every cell whose room bit is set in s->grid (which s must not
+** already hold), as when the grid has been read back from a checkpoint.
+*/
+void
+spatial_rebuild(Spatial *s) {
+   Grid *g = s->grid;
+   for(int i = 0 ; i < g->tilesPerSide * g->tilesPerSide ; i++) {
+      Tile *t = g->tiles[i];
+      if (t == NULL)
+         continue;
+      int k = 0;
+      for(int lx = 0 ; lx < TILE_SIZE ; lx++)
+         for(int ly = 0 ; ly < TILE_SIZE ; ly++)
+            if (TILE_BIT(t->occupied, lx, ly)) {
+               if (TILE_BIT(t->room, lx, ly))
+                  spatial_insert(s, cell_from_id(t->ids[k]), t->ids[k]);
+               k++;
+            }
+   }
+}//spatial_rebuild()
+
+/*
+** Add c (whose id is id) to the index.
+*/
+void
+spatial_insert(Spatial *s, Cell *c, CellId id) {
+   assert(c->slot < 0);
+   Bucket *b = s->buckets + (c->p.x / SPATIAL_BUCKET) * s->bucketsPerSide + c->p.y / SPATIAL_BUCKET;
+   if (b->len == b->cap) {
+      b->cap = b->cap == 0 ? 8 : 2 * b->cap;
+      b->e = (SpatialEntry *)realloc(b->e, sizeof(SpatialEntry) * b->cap);
+      assert(b->e != NULL);
+   }
+   b->e[b->len].p  = c->p;
+   b->e[b->len].id = id;
+   c->slot = b->len++;
+   grid_set_room(s->grid, c->p.x, c->p.y, 1);
+}//spatial_insert()
+
+/*
+** Remove c from the index if it is there.
+*/
+void
+spatial_remove(Spatial *s, Cell *c) {
+   if (c->slot < 0)
+      return;
+   Bucket *b = s->buckets + (c->p.x / SPATIAL_BUCKET) * s->bucketsPerSide + c->p.y / SPATIAL_BUCKET;
+   b->len--;
+   if (c->slot != b->len) {     // move last entry into the hole
+      b->e[c->slot] = b->e[b->len];
+      cell_from_id(b->e[c->slot].id)->slot = c->slot;
+   }
+   c->slot = -1;
+   grid_set_room(s->grid, c->p.x, c->p.y, 0);
+}//spatial_remove()
+
+/*
+** Check every entry of bucket (bx,by) against p, keeping the lowest rank
+** in *bestRank and its entry in *best. Returns the number of entries.
+*/
+static int
+scan_bucket(Spatial *s, int bx, int by, Point p, int *bestRank, SpatialEntry **best) {
+   Bucket *b = s->buckets + bx * s->bucketsPerSide + by;
+   int w = 2 * s->radius + 1;
+   for(SpatialEntry *e = b->e ; e < b->e + b->len ; e++) {
+      int dx = e->p.x - p.x;
+      int dy = e->p.y - p.y;
+      if (dx < -s->radius || dx > s->radius) continue;
+      if (dy < -s->radius || dy > s->radius) continue;
+      int r = s->rank[(dx + s->radius) * w + dy + s->radius];
+      if (r < 0 || r >= *bestRank) continue;  // outside radius, self, or further away
+      if (cross_raphe(p, e->p)) continue;
+      *bestRank = r;
+      *best = e;
+   }
+   return b->len;
+}//scan_bucket()
+
+/*
+** Return the indexed cell closest to p (ties broken by scanPoints order)
+** that is not across the raphe from p, or NULL if there is none within radius.
+** The number of entries looked at is added to *examined (if not NULL).
+*/
+Cell *
+spatial_nearest(Spatial *s, Point p, long *examined) {
+   int seen = 0;
+   int bx = p.x / SPATIAL_BUCKET;
+   int by = p.y / SPATIAL_BUCKET;
+   int bestRank = INT_MAX;
+   long bestD2 = LONG_MAX;
+   SpatialEntry *best = NULL;
+
+   for(int k = 0 ; ; k++) {
+         // every pixel in ring k is at least gap from p
+      long gap = k == 0 ? 0 : (long)(k - 1) * SPATIAL_BUCKET + 1;
+      if (gap > s->radius) break;
+      if (gap * gap > bestD2) break;
+
+      for(int i = bx - k ; i <= bx + k ; i++) {
+         if (i < 0 || i >= s->bucketsPerSide) continue;
+         if (i == bx - k || i == bx + k) {   // whole column
+            for(int j = by - k ; j <= by + k ; j++)
+               if (j >= 0 && j < s->bucketsPerSide)
+                  seen += scan_bucket(s, i, j, p, &bestRank, &best);
+         } else {                            // top and bottom only
+            if (by - k >= 0)
+               seen += scan_bucket(s, i, by - k, p, &bestRank, &best);
+            if (by + k < s->bucketsPerSide)
+               seen += scan_bucket(s, i, by + k, p, &bestRank, &best);
+         }
+      }
+
+      if (best != NULL) {
+         long dx = best->p.x - p.x;
+         long dy = best->p.y - p.y;
+         bestD2 = dx * dx + dy * dy;
+      }
+   }
+
+   if (examined != NULL)
+      *examined += seen;
+   return best == NULL ? NULL : cell_from_id(best->id);
+}//spatial_nearest()
@@ -0,0 +1,47 @@
+#ifndef _SPATIAL_H_
+#define _SPATIAL_H_
+
+#include "types.h"
+#include "grid.h"
+
+/*
+** Spatial index of the cells that a new path could join: those with
+** path != NULL and count < thickness. Cells are kept in a uniform grid of
+** SPATIAL_BUCKET*SPATIAL_BUCKET pixel buckets, and each indexed cell
+** records its position in its bucket (Cell.slot) so removal is O(1).
+** Membership is mirrored in the grid's room bits (grid_set_room).
+*/
+
+#define SPATIAL_BUCKET 32   // pixels per bucket side
+
+typedef struct spatialEntry {
+   Point p;
+   CellId id;
+} SpatialEntry;
+
+typedef struct bucket {
+   int len;             // e[0..len-1] are valid
+   int cap;
+   SpatialEntry *e;
+} Bucket;
+
+typedef struct spatial {
+   Grid *grid;          // whose room bits follow membership
+   int bucketsPerSide;
+   Bucket *buckets;     // buckets[bx * bucketsPerSide + by]
+   int radius;          // nothing further than this (pixels) is ever returned
+   int *rank;           // rank[(dx+radius)*(2*radius+1) + dy+radius] = index of (dx,dy) in
+                        // scanPoints, or -1 if (dx,dy) is not a scan point
+   int ownsRank;        // 0 if rank belongs to the index this was cloned from
+} Spatial;
+
+Spatial *spatial_new(Grid *grid, PointD *scanPoints, int scanPointLen, int radius);
+Spatial *spatial_clone(const Spatial *proto, Grid *grid);
+void spatial_free(Spatial *s);
+void spatial_clear(Spatial *s);
+void spatial_rebuild(Spatial *s);
+void spatial_insert(Spatial *s, Cell *c, CellId id);
+void spatial_remove(Spatial *s, Cell *c);
+Cell *spatial_nearest(Spatial *s, Point p, long *examined);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+** Phase timers and counters: see stats.h
+*/
+
+#define _POSIX_C_SOURCE 200809L   // for clock_gettime() under -std=c99
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "types.h"
+#include "cells.h"
+#include "stats.h"
+
+static const char *phaseNames[NUM_PHASES] = {"init_grid", "init_cells", "init_scanPoints", "process", "rnfl"};
+
+static struct {
+   double wall, cpu;          // total seconds
+   double wallAt, cpuAt;      // at stats_phase_start()
+   int calls;
+} phases[NUM_PHASES];
+
+static double
+seconds(clockid_t clock) {
+   struct timespec ts;
+   clock_gettime(clock, &ts);
+   return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}//seconds()
+
+void
+stats_phase_start(int phase) {
+   phases[phase].wallAt = seconds(CLOCK_MONOTONIC);
+   phases[phase].cpuAt  = seconds(CLOCK_PROCESS_CPUTIME_ID);
+}//stats_phase_start()
+
+void
+stats_phase_stop(int phase) {
+   phases[phase].wall += seconds(CLOCK_MONOTONIC) - phases[phase].wallAt;
+   phases[phase].cpu  += seconds(CLOCK_PROCESS_CPUTIME_ID) - phases[phase].cpuAt;
+   phases[phase].calls++;
+}//stats_phase_stop()
+
+/*
+** Zero the phase times, for the next run of a sweep.
+*/
+void
+stats_phase_reset() {
+   for(int p = 0 ; p < NUM_PHASES ; p++)
+      phases[p].wall = phases[p].cpu = phases[p].calls = 0;
+}//stats_phase_reset()
+
+void
+stats_add(Stats *to, const Stats *from) {
+   to->closestCalls      += from->closestCalls;
+   to->closestSpeculated += from->closestSpeculated;
+   to->closestExamined   += from->closestExamined;
+   to->newPathCalls      += from->newPathCalls;
+   to->newPathSpeculated += from->newPathSpeculated;
+   to->fakeCells       += from->fakeCells;
+   to->nodesCopied     += from->nodesCopied;
+   to->nodesShared     += from->nodesShared;
+   to->alternateHits   += from->alternateHits;
+}//stats_add()
+
+/*
+** Write the phase times, s, what became of each cell of cellBlock and
+** the peak resident set size to f as a JSON object.
+*/
+void
+stats_write(FILE *f, const Stats *s) {
+   fprintf(f, "{\n  \"phases\": {");
+   for(int p = 0 ; p < NUM_PHASES ; p++)
+      fprintf(f, "%s\n    \"%s\": {\"wall\": %.6f, \"cpu\": %.6f, \"calls\": %d}",
+         p == 0 ? "" : ",", phaseNames[p], phases[p].wall, phases[p].cpu, phases[p].calls);
+   fprintf(f, "\n  },\n");
+
+   long status[256] = {0};
+   for(int i = 0 ; i < numCells ; i++)
+      status[(unsigned char)cellBlock[i].status]++;
+   fprintf(f, "  \"cells\": {\"total\": %d, \"start\": %ld, \"grown\": %ld, \"failed\": %ld, \"no_near\": %ld, \"ungrown\": %ld},\n",
+      numCells, status[CELL_START], status[CELL_GROWN], status[CELL_FAILED], status[CELL_NO_NEAR], status[CELL_UNGROWN]);
+
+   long searches = s->closestCalls - s->closestSpeculated;
+   fprintf(f, "  \"findClosestCompleted\": {\"calls\": %ld, \"speculated\": %ld, \"examined\": %ld, \"examined_per_search\": %.3f},\n",
+      s->closestCalls, s->closestSpeculated, s->closestExamined, searches == 0 ? 0.0 : (double)s->closestExamined / searches);
+   fprintf(f, "  \"findNewPath\": {\"calls\": %ld, \"speculated\": %ld, \"fake_cells\": %ld},\n",
+      s->newPathCalls, s->newPathSpeculated, s->fakeCells);
+   fprintf(f, "  \"makeOnePath\": {\"nodes_copied\": %ld, \"nodes_shared\": %ld, \"alternate_hits\": %ld},\n",
+      s->nodesCopied, s->nodesShared, s->alternateHits);
+
+   struct rusage ru;
+   getrusage(RUSAGE_SELF, &ru);
+   fprintf(f, "  \"peak_rss_kb\": %ld\n}\n", (long)ru.ru_maxrss);   // kilobytes on Linux
+}//stats_write()
@@ -0,0 +1,49 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+
+/*
+** Where a run spends its time, and how much work its searches do.
+**
+** Phases: wall and CPU time (of every thread) of the steps of a run, summed
+** over each stats_phase_start() ... stats_phase_stop() of the phase.
+**
+** Counters are per Sector (sec->stats), so only the thread growing a sector
+** touches them, and each is a plain increment, cheap enough to leave on.
+** sectors_merge() adds each wedge's into whole's. speculate() counts nothing:
+** it runs on many threads and may be thrown away. When grow() takes its answer
+** rather than searching, the call is still counted, and counted again as
+** speculated, so calls are the same for any number of threads; only the
+** searches actually made (calls less speculated) are in examined.
+**
+** stats_write() writes both as a JSON object (stack -j), with the failures
+** (# K and # Kn) from the cells' status and the peak resident set size.
+*/
+
+#define PHASE_INIT_GRID  0
+#define PHASE_INIT_CELLS 1
+#define PHASE_INIT_SCAN  2
+#define PHASE_PROCESS    3
+#define PHASE_RNFL       4   // rnfl_write(), with stack -r or --oct
+#define NUM_PHASES       5
+
+typedef struct stats {
+   long closestCalls;      // findClosestCompleted(), by grow()...
+   long closestSpeculated; // ...of which answered by speculate()
+   long closestExamined;   // spatial index entries the others looked at
+   long newPathCalls;      // findNewPath()...
+   long newPathSpeculated; // ...of which answered by speculate()'s search
+   long fakeCells;         // made by findNewPath()
+   long nodesCopied;       // path Nodes makeOnePath() copied up to a full cell...
+   long nodesShared;       // ...or joined on to without copying
+   long alternateHits;     // full cells whose alternate was used again, without findNewPath()
+} Stats;
+
+void stats_phase_start(int phase);
+void stats_phase_stop(int phase);
+void stats_phase_reset();
+void stats_add(Stats *to, const Stats *from);
+void stats_write(FILE *f, const Stats *s);
+
+#endif
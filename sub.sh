@@ -7,6 +7,10 @@
 
 #  qsub -I -X -l pvmem=20gb  # interactive
 
-module load gsl-gcc/1.14 gtk-gcc/2.22.0 
+   # needs glib 2.32 or later (for GMutex, GCond and g_thread_new())
 
-./stack
+   # carry on from the last checkpoint if an earlier job was killed
+   # (stack removes it once a run is done)
+RESUME=""
+if [ -f stack.ckpt ]; then RESUME="--resume"; fi
+./stack -k stack.ckpt -o stack.out $RESUME
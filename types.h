@@ -1,6 +1,7 @@
 #ifndef _TYPES_H_ 
 #define _TYPES_H_ 
 
+#include <stdint.h>
 #include "queue.h"
 
 typedef unsigned char uchar;
@@ -15,29 +16,49 @@ typedef struct pointD {
    float dist;
 } PointD;
 
+typedef uint32_t CellId;    // see cells.h
+typedef uint32_t NodeId;
+
 typedef struct cell Cell; 
+typedef struct cellRoom CellRoom;
 typedef struct node Node;
 struct node {
-   Cell *c;
-   Node *next;
+   CellId c;
+   NodeId next;
 };
 
 struct cell {
    Point p;
-   Node *path;       // a linked list of cells that path jumps along
+   NodeId path;      // a linked list of cells that path jumps along
                      // first element of path is self
    //float distToOnh;
-   unsigned int count;        // count of paths that go through this cell
-   unsigned int thickness;    // number of paths that are allowed to go through this cell
-
-   char flag;        // used for various, initially all 0 
+   int slot;         // position in its spatial index bucket, -1 if not indexed
 
-   Cell *alternate;  // if a path tried to come through this, but was full so had to do find,
+   CellId alternate; // if a path tried to come through this, but was full so had to do find,
                      // this records the result of the find.
+   char status;      // CELL_GROWN, ... as reported (see pathfile.h)
+};
+
+   // The part of a cell looked at for every node a path follows, kept apart
+   // from the Cell (by the same id, see ROOM() in cells.h) so that a cache
+   // line holds 5 of them rather than 2 whole cells.
+struct cellRoom {
+   uint32_t count;      // count of paths that go through this cell
+   uint32_t mark;       // of the last path or segment to visit it, 0 if none (see sector.h)
+   uint16_t thickness;  // number of paths that are allowed to go through this cell,
+                        // THICK_UNLIMITED for start cells
+   uint16_t pad;
 };
 
-typedef struct grid {
-   Cell *soma;  // ptr to cell at this location
-} Grid; 
+#define THICK_UNLIMITED UINT16_MAX   // CellRoom.thickness of a start cell: no limit
+
+   // Cell.status, the same as PfCell.status in pathfile.h
+#define CELL_UNGROWN  0     // never grown
+#define CELL_START   'S'    // within START_DIST of the ONH
+#define CELL_GROWN   'G'    // has a path to the ONH
+#define CELL_FAILED  'K'    // no path could be made
+#define CELL_NO_NEAR 'N'    // no completed cell within NEW_PATH_RADIUS_LIMIT
+
+typedef struct grid Grid;   // see grid.h
 
 #endif